@@ -0,0 +1,58 @@
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+	$$PWD/marker_tracker_engine.cpp \
+	$$PWD/marker_variant.cpp \
+	$$PWD/polygon_triangulator.cpp \
+	$$PWD/pattern_classifier.cpp
+
+HEADERS += \
+	$$PWD/marker_tracker_engine.h \
+	$$PWD/marker_variant.h \
+	$$PWD/polygon_triangulator.h \
+	$$PWD/pattern_classifier.h
+
+win32 {
+
+    QMAKE_INCDIR += \
+        $$PWD/include \
+        $$(OpenCV_DIR)/include
+
+    QMAKE_LIBDIR += \
+        $$PWD/lib \
+        $$(OpenCV_DIR)/x86/vc12/lib
+
+    CONFIG(debug, debug|release) {
+        QMAKE_LIBS += \
+            -laruco130d
+    }
+
+    CONFIG(release, debug|release) {
+        QMAKE_LIBS += \
+            -laruco130
+    }
+
+} macx {
+
+	QMAKE_INCDIR += \
+		$$PWD/include \
+		/usr/local/include
+
+	QMAKE_LIBDIR += \
+		$$PWD/lib \
+		/usr/local/lib
+
+	QMAKE_LIBS += \
+		-laruco -lopencv_core -lopencv_video
+
+}
+
+unix:!macx {
+
+	QMAKE_INCDIR += \
+		$$PWD/include
+
+	QMAKE_LIBS += \
+		-laruco
+
+}
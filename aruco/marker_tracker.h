@@ -2,93 +2,17 @@
 #define MARKER_DETECTOR_H
 
 #include <QVariantList>
-#include <thread>
-#include <deque>
 #include "image.h"
+#include "marker_tracker_engine.h"
+#include "stage_worker.h"
+#include "pipeline_stage.h"
 
 
 namespace Littai
 {
 
-class TrackedEdge : public cv::Point
-{
-public:
-    TrackedEdge(const cv::Point& point)
-        : cv::Point(point)
-        , frameCount(0)
-        , lostCount(0)
-        , checked(false)
-        , activated(false)
-    {}
-    int id;
-    cv::Point2d direction;
-    int frameCount;
-    int lostCount;
-    bool checked;
-    bool activated;
-
-    static int GetId()
-    {
-        return currentId++;
-    }
-
-private:
-    static int currentId;
-};
-
-
-struct TrackedPattern
-{
-    std::vector<int> edgeIds;
-    int pattern;
-};
-
-
-struct TrackedMarker
-{
-
-    unsigned int id;
-    double x, y;
-    double vx, vy;
-    double px, py;
-    std::chrono::system_clock::time_point t;
-    double trackedX, trackedY;
-    double angle;
-    double trackedAngle;
-    double size;
-    int frameCount;
-    int lostCount;
-    bool checked;
-    cv::Rect bound;
-    std::vector<cv::Point> polygon;
-    std::vector<int> indices;
-    std::vector<TrackedEdge> edges;
-    std::vector<TrackedPattern> patterns;
-    cv::Mat image;
-
-    TrackedMarker()
-        : id(-1), x(0), y(0), vx(0), vy(0), px(0), py(0), trackedX(0), trackedY(0), angle(0), trackedAngle(-1)
-        , frameCount(0), lostCount(0), checked(false)
-    {
-    }
-
-    void update(const TrackedMarker& other)
-    {
-        x     = other.x;
-        y     = other.y;
-        angle = other.angle;
-        size  = other.size;
-    }
-
-    void print()
-    {
-        qDebug("id: %d  x: %.2f  y: %.2f  angle: %.2f  frame: %d",
-            id, x, y, angle, frameCount);
-    }
-};
 
-
-class MarkerTracker : public Image
+class MarkerTracker : public Image, public PipelineStage
 {
     Q_OBJECT
     Q_PROPERTY(QVariant inputImage WRITE setInputImage READ inputImage NOTIFY inputImageChanged)
@@ -98,6 +22,9 @@ class MarkerTracker : public Image
     Q_PROPERTY(int contrastThresholdStep MEMBER contrastThresholdStep_ NOTIFY contrastThresholdStepChanged)
     Q_PROPERTY(int fps MEMBER fps_ NOTIFY fpsChanged)
     Q_PROPERTY(int predictionFrame MEMBER predictionFrame_ NOTIFY predictionFrameChanged)
+    Q_PROPERTY(int averageFrames MEMBER averageFrames_ NOTIFY averageFramesChanged)
+    Q_PROPERTY(bool isOutputImage MEMBER isOutputImage_ NOTIFY isOutputImageChanged)
+    Q_PROPERTY(QString patternFile WRITE setPatternFile READ patternFile NOTIFY patternFileChanged)
     Q_PROPERTY(QVariantList markers READ markers NOTIFY markersChanged)
 
 public:
@@ -107,35 +34,28 @@ public:
     void setInputImage(const QVariant& image);
     QVariant inputImage() const;
     QVariantList markers() const;
+    void setPatternFile(const QString& path);
+    QString patternFile() const;
 
-private:
-    void track();
-    void preProcess(cv::Mat& image);
-    void detectMarkers(cv::Mat& resultImage, cv::Mat& inputImage);
-    void detectPolygons(cv::Mat& resultImage, cv::Mat& inputImage);
-    void detectMotions(cv::Mat& resultImage, cv::Mat& inputImage);
-    void detectPatterns(cv::Mat& resultImage, cv::Mat& inputImage);
-    void predictPosition();
-    std::vector<int> triangulatePolygons(const std::vector<cv::Point>& polygon);
+    Stage& stage() override;
+    void updateParams() override;
+    void setOutput(const cv::Mat& output) override;
 
-    std::thread thread_;
-    mutable std::mutex mutex_;
-    bool isFinished_;
-    bool isImageUpdated_;
+private:
+    MarkerTrackerEngine engine_;
+    StageWorker worker_;
 
     cv::Mat inputImage_;
-    std::deque<cv::Mat> imageCaches_;
-    cv::Mat historyImage_;
-    cv::Mat preImage_;
-    const std::chrono::system_clock::time_point startTime_;
+    mutable std::mutex mutex_;
+    cv::Size outputSize_;
 
     int contrastThreshold_;
     int contrastThresholdMin_, contrastThresholdMax_, contrastThresholdStep_;
     int fps_;
     int predictionFrame_;
-    int frameCount_;
-
-    std::list<TrackedMarker> markers_;
+    int averageFrames_;
+    bool isOutputImage_;
+    QString patternFile_;
 
 signals:
     void inputImageChanged() const;
@@ -147,6 +67,9 @@ signals:
     void fpsChanged() const;
     void markersChanged() const;
     void predictionFrameChanged() const;
+    void averageFramesChanged() const;
+    void isOutputImageChanged() const;
+    void patternFileChanged() const;
 };
 
 }
@@ -0,0 +1,797 @@
+﻿#if defined _WIN32 || defined _WIN64
+#pragma warning( disable : 4290 )
+#define _USE_MATH_DEFINES
+#endif
+
+#include <algorithm>
+#include <numeric>
+#include <aruco.h>
+#include <opencv2/opencv.hpp>
+#include "marker_tracker_engine.h"
+#include "vector_math.h"
+#include "assignment.h"
+#include "pattern_classifier.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // 輪郭の形のハッシュ（先頭の点からの相対座標なので平行移動では変わらない）
+    unsigned long long contourChecksum(const std::vector<cv::Point>& contour)
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (const auto& point : contour) {
+            const auto d = point - contour[0];
+            hash = (hash ^ static_cast<unsigned int>(d.x)) * 1099511628211ULL;
+            hash = (hash ^ static_cast<unsigned int>(d.y)) * 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+
+
+int TrackedEdge::currentId = 0;
+
+
+MarkerTrackerEngine::MarkerTrackerEngine()
+    : nextClassifier_(std::make_shared<PatternClassifier>())
+    , frameCount_(0)
+{
+}
+
+
+std::string MarkerTrackerEngine::name() const
+{
+    return "marker";
+}
+
+
+void MarkerTrackerEngine::setParams(const Params& params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    nextParams_ = params;
+}
+
+
+MarkerTrackerEngine::Params MarkerTrackerEngine::params() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nextParams_;
+}
+
+
+std::vector<TrackedMarker> MarkerTrackerEngine::markers() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publishedMarkers_;
+}
+
+
+bool MarkerTrackerEngine::loadPatterns(const std::string& path)
+{
+    auto classifier = std::make_shared<PatternClassifier>();
+    if (!classifier->load(path)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    nextClassifier_ = classifier;
+    return true;
+}
+
+
+void MarkerTrackerEngine::process(const cv::Mat& input, cv::Mat& output)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        params_ = nextParams_;
+        classifier_ = nextClassifier_;
+    }
+
+    if (input.empty()) {
+        output.release();
+        return;
+    }
+
+    cv::Mat image, gray;
+    input.copyTo(image);
+
+    cv::Mat rawGray;
+    cv::cvtColor(image, rawGray, cv::COLOR_BGR2GRAY);
+
+    // cv::Mat raw;
+    // cv::cvtColor(image, raw, cv::COLOR_BGR2GRAY);
+
+    // ガンマ補正 / 複数枚平均
+    preProcess(image);
+
+    // グレースケール
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+
+    // マーカ認識
+    detectMarkers(image, rawGray);
+
+    // 認識できなかったマーカの位置と回転を前フレームからの動きで補う
+    // （補った位置でポリゴンを探すので先に行う）
+    detectMotions(image, rawGray);
+
+    // ポリゴン認識
+    detectPolygons(image, gray);
+
+    // エッジの配置からルールベースでパターンを認識
+    detectPatterns(image, gray);
+
+    output = image;
+    ++frameCount_;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        publishedMarkers_.assign(markers_.begin(), markers_.end());
+    }
+}
+
+
+void MarkerTrackerEngine::preProcess(cv::Mat &image)
+{
+    // センサのノイズを複数フレームの平均で抑える
+    averager_.setFrames(params_.averageFrames);
+    averager_.apply(image);
+
+    // ノイズリダクションと 2 値化
+    // OTSU も試してみたけど、アダプティブにしてしまうと安定しない..
+    cv::threshold(image, image, params_.contrastThreshold, 255, cv::THRESH_BINARY);
+    cv::medianBlur(image, image, 3);
+    // cv::dilate(image, image, cv::Mat(), cv::Point(-1, -1), 1);
+}
+
+
+void MarkerTrackerEngine::detectMarkers(cv::Mat &resultImage, cv::Mat &inputImage)
+{
+    const double scale = 1.0;
+    cv::Mat image;
+    cv::resize(inputImage, image, cv::Size(), scale, scale, cv::INTER_LINEAR);
+
+    // ArUco によるマーカの認識
+    // スレッショルドを振って 3 回行う
+    aruco::MarkerDetector detector;
+    detector.setMinMaxSize(0.01f, 0.07f);
+    detector.setThresholdMethod(aruco::MarkerDetector::FIXED_THRES);
+    detector.setCornerRefinementMethod(aruco::MarkerDetector::CornerRefinementMethod::SUBPIX);
+    detector.setThresholdParams(params_.contrastThreshold, 0);
+    std::vector<int> thresholds;
+    for (int t = params_.contrastThresholdMin; t <= params_.contrastThresholdMax; t += params_.contrastThresholdStep) {
+        thresholds.push_back(t);
+    }
+    std::vector<std::vector<aruco::Marker>> tmpMarkersList(thresholds.size());
+
+    #pragma omp parallel for
+    for (unsigned int i = 0; i < thresholds.size(); ++i) {
+        cv::Mat binaryImage, filteredImage;
+        cv::threshold(image, binaryImage, thresholds[i], 255, cv::THRESH_BINARY);
+        cv::medianBlur(binaryImage, filteredImage, 3);
+        detector.detect(filteredImage, tmpMarkersList[i]);
+    }
+
+    std::vector<aruco::Marker> markers;
+    for (const auto& tmpMarkers : tmpMarkersList) {
+        for (const auto& marker : tmpMarkers) {
+            const auto it = std::find_if(markers.begin(), markers.end(), [&marker](const aruco::Marker& existingMarker) {
+                return marker.id == existingMarker.id;
+            });
+            if (it == markers.end()) {
+                markers.push_back(marker);
+            }
+        }
+    }
+
+    // 結果を格納
+    std::vector<TrackedMarker> newMarkers;
+    for (auto&& marker : markers) {
+        const auto sum = std::accumulate(marker.begin(), marker.end(), cv::Point2f(0.f));
+
+        TrackedMarker info;
+        info.id = marker.id;
+        info.x = sum.x / marker.size() / scale;
+        info.y = sum.y / marker.size() / scale;
+        const auto side = marker[0] - marker[3];
+        info.angle = std::atan2(side.x, side.y);
+        info.size = len(side);
+
+        newMarkers.push_back(info);
+    }
+
+    // フラグをオフにしておく
+    for (auto&& marker : markers_) {
+        marker.checked = false;
+    }
+
+    // 見つかったアイテムは情報を更新してフラグを立てる
+    for (auto&& newMarker : newMarkers) {
+        bool isFound = false;
+        for (auto&& marker : markers_) {
+            if (newMarker.id == marker.id) {
+                isFound = true;
+                marker.update(newMarker);
+                marker.checked = true;
+                break;
+            }
+        }
+        if (!isFound) {
+            markers_.push_back(newMarker);
+        }
+    }
+
+    // しばらく認識されなかったマーカは削除
+    // 認識されたアイテムはフレームカウントを増加
+    for (auto it = markers_.begin(); it != markers_.end();) {
+        auto& marker = *it;
+        if (marker.checked) {
+            marker.lostCount = 0;
+        } else {
+            marker.lostCount++;
+            if (marker.lostCount > 30) {
+                polygonCaches_.erase(marker.id);
+                it = markers_.erase(it);
+                continue;
+            }
+        }
+        ++marker.frameCount;
+        ++it;
+    }
+
+    // マーカの位置補正
+    predictPosition();
+
+    /*
+    for (auto&& marker : markers_) {
+        marker.print();
+    }
+    */
+}
+
+
+void MarkerTrackerEngine::predictPosition()
+{
+    for (auto&& marker : markers_) {
+        if (!marker.checked) continue;
+
+        const auto dx = marker.x - marker.px;
+        const auto dy = marker.y - marker.py;
+        marker.px = marker.x;
+        marker.py = marker.y;
+
+        const auto now = std::chrono::system_clock::now();
+        const auto dt = std::chrono::duration_cast<std::chrono::microseconds>(now - marker.t).count();
+        marker.t = now;
+
+        if (marker.frameCount < 2) continue;
+
+        marker.vx += (dx / dt - marker.vx) * 0.5;
+        marker.vy += (dy / dt - marker.vy) * 0.5;
+
+        const double predictionDuration = (1000.0 * 1000.0) / params_.fps * params_.predictionFrame;
+        marker.x += marker.vx * predictionDuration;
+        marker.y += marker.vy * predictionDuration;
+    }
+}
+
+
+std::map<unsigned int, std::vector<cv::Point>> MarkerTrackerEngine::findMarkerRegions(const cv::Mat& image)
+{
+    std::map<unsigned int, std::vector<cv::Point>> contourMap;
+    if (markers_.empty()) return contourMap;
+
+    // 外周から背景を塗りつぶし、残り（物体と穴）を前景 -1 とするラベル画像を作る
+    // （穴の中にマーカの中心があっても外側の輪郭に含まれるようにするため）
+    // 外周を 1 画素広げておけば (0, 0) からの塗りつぶしで背景がすべて届く
+    cv::Mat binary;
+    cv::copyMakeBorder(image > 0, binary, 1, 1, 1, 1, cv::BORDER_CONSTANT, cv::Scalar(0));
+    cv::floodFill(binary, cv::Point(0, 0), cv::Scalar(128), nullptr, cv::Scalar(0), cv::Scalar(0), 4);
+    regionLabels_.create(binary.size(), CV_32SC1);
+    regionLabels_.setTo(cv::Scalar(-1));
+    regionLabels_.setTo(cv::Scalar(0), binary == 128);
+
+    // マーカの中心のラベルを引き、まだラベルが無ければその連結成分だけ塗って輪郭を取る
+    std::map<int, std::vector<cv::Point>> regions;
+    int nextLabel = 1;
+    for (const auto& marker : markers_) {
+        const cv::Point center(marker.x + 1, marker.y + 1);
+        if (center.x < 1 || center.y < 1 || center.x > image.cols || center.y > image.rows) continue;
+
+        int label = regionLabels_.at<int>(center);
+        if (label == 0) continue;
+
+        if (label < 0) {
+            label = nextLabel++;
+            cv::Rect bound;
+            cv::floodFill(regionLabels_, center, cv::Scalar(label), &bound, cv::Scalar(0), cv::Scalar(0), 8);
+
+            // 成分の外接矩形の中だけで輪郭を追う
+            bound.x -= 1;
+            bound.y -= 1;
+            bound.width  += 2;
+            bound.height += 2;
+            cv::Mat component = (regionLabels_(bound) == label);
+            std::vector<std::vector<cv::Point>> contours;
+            cv::findContours(component, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_TC89_KCOS, bound.tl() - cv::Point(1, 1));
+            if (contours.empty()) continue;
+
+            auto largest = std::max_element(contours.begin(), contours.end(),
+                [](const std::vector<cv::Point>& a, const std::vector<cv::Point>& b) {
+                    return a.size() < b.size();
+                });
+            regions[label] = *largest;
+        }
+
+        auto it = regions.find(label);
+        if (it != regions.end()) {
+            contourMap.emplace(marker.id, it->second);
+        }
+    }
+
+    return contourMap;
+}
+
+
+void MarkerTrackerEngine::detectPolygons(cv::Mat &resultImage, cv::Mat &inputImage)
+{
+    // マーカを囲む領域を認識
+    cv::dilate(inputImage, regionImage_, cv::Mat());
+    const auto contourMap = findMarkerRegions(regionImage_);
+
+    for (auto&& marker : markers_) {
+        const cv::Point center(marker.x, marker.y);
+
+        auto it = contourMap.find(marker.id);
+        if (it == contourMap.end()) continue;
+        auto& contour = (*it).second;
+
+        std::vector<std::vector<cv::Point>> contours = { contour };
+        cv::drawContours(resultImage, contours, 0, cv::Scalar(255, 0, 0), 3);
+        if (contour.empty()) continue;
+
+        // 輪郭の形が同じで、マーカもほとんど動いていなければ前回の結果を平行移動して使う
+        auto& cache = polygonCaches_[marker.id];
+        const auto checksum = contourChecksum(contour);
+        const auto dAngle = std::atan2(std::sin(marker.angle - cache.angle), std::cos(marker.angle - cache.angle));
+        const bool isStill =
+            cache.checksum == checksum &&
+            std::abs(marker.x - cache.x) <= 2.0 &&
+            std::abs(marker.y - cache.y) <= 2.0 &&
+            std::abs(dAngle) <= 0.05;
+        if (isStill) {
+            const auto offset = contour[0] - cache.origin;
+            if (offset != cv::Point()) {
+                for (auto&& vertex : cache.polygon) vertex += offset;
+                for (auto&& edge : cache.edges) edge += offset;
+                cache.origin = contour[0];
+            }
+        } else {
+            buildPolygon(cache, contour, center, inputImage.size());
+            cache.x = marker.x;
+            cache.y = marker.y;
+            cache.angle = marker.angle;
+            cache.checksum = checksum;
+            cache.origin = contour[0];
+        }
+
+        // 多すぎる場合はスキップ
+        if (!cache.isValid) continue;
+
+        const auto& polygon = cache.polygon;
+        marker.polygon = polygon;
+        marker.indices = cache.indices;
+
+        // 突端認識
+        if (polygon.size() >= 4) {
+            auto edges = cache.edges;
+
+            // Raw の Edge を描画
+            for (const auto& edge : edges) {
+                cv::circle(resultImage, edge, 6, cv::Scalar(0, 255, 0), 2);
+            }
+
+            // 過去に登録されたエッジとマーカ基準の座標で比べ、距離の和が最小になるように対応づける
+            // 対応しなかったものは新しいエッジとして追加
+            // （画面上の向きは -angle 回っているので、angle 回して戻す）
+            const cv::Point2d markerPos(marker.x, marker.y);
+            for (auto&& newEdge : edges) {
+                newEdge.local = rotate(cv::Point2d(newEdge) - markerPos, marker.angle);
+            }
+            const int rows = static_cast<int>(edges.size());
+            const int cols = static_cast<int>(marker.edges.size());
+            std::vector<double> cost(rows * cols);
+            for (int i = 0; i < rows; ++i) {
+                for (int j = 0; j < cols; ++j) {
+                    cost[i * cols + j] = len(edges[i].local - marker.edges[j].local);
+                }
+            }
+            // 駒の外接矩形の長辺の 1/4 より離れたものは別のエッジとみなす
+            const auto extent = cv::boundingRect(polygon);
+            const auto maxCost = std::max(extent.width, extent.height) * 0.25;
+            const auto assignment = solveAssignment(cost, rows, cols, maxCost);
+
+            for (auto&& existingEdge : marker.edges) {
+                existingEdge.checked = false;
+            }
+            std::vector<TrackedEdge> newEdges;
+            for (int i = 0; i < rows; ++i) {
+                auto& newEdge = edges[i];
+                if (assignment[i] >= 0) {
+                    auto& existingEdge = marker.edges[assignment[i]];
+                    existingEdge.x = newEdge.x;
+                    existingEdge.y = newEdge.y;
+                    existingEdge.direction = newEdge.direction;
+                    existingEdge.local = newEdge.local;
+                    existingEdge.checked = true;
+                } else {
+                    newEdge.id = TrackedEdge::GetId();
+                    newEdges.push_back(newEdge);
+                }
+            }
+
+            // 一定期間見つからなかったら削除
+            for (auto it = marker.edges.begin(); it != marker.edges.end();) {
+                auto& edge = *it;
+                if (edge.checked) {
+                    edge.lostCount = 0;
+                    ++edge.frameCount;
+                    if (edge.frameCount > 5) {
+                        edge.activated = true;
+                    }
+                } else {
+                    ++edge.lostCount;
+                    if (edge.lostCount > 3) {
+                        edge.activated = false;
+                    }
+                    if (edge.lostCount > 8) {
+                        it = marker.edges.erase(it);
+                        continue;
+                    }
+                }
+                ++it;
+            }
+
+            // 新しいエッジを追加
+            for (const auto& newEdge : newEdges) {
+                marker.edges.push_back(newEdge);
+            }
+        }
+
+        if (polygon.size() >= 3) {
+            marker.bound = cv::boundingRect(polygon);
+        }
+    }
+
+    for (auto&& marker : markers_) {
+        // 中心と領域を描画
+        const cv::Point center(marker.x, marker.y);
+        cv::circle(resultImage, center, marker.size / 2, cv::Scalar(0, 255, 0), 2);
+
+        for (const auto& vertex : marker.polygon) {
+            cv::circle(resultImage, vertex, 3, cv::Scalar(0, 0, 255), 2);
+        }
+
+        // 認識したエッジを描画
+        for (const auto& edge : marker.edges) {
+            if (edge.activated) {
+                cv::circle(resultImage, edge, 6, cv::Scalar(0, 255, 255), -1);
+                const cv::Point2d from = edge;
+                const cv::Point2d to = from + edge.direction * 6;
+                cv::arrowedLine(resultImage, from, to, CV_RGB(0, 255, 0), 1);
+            } else {
+                cv::circle(resultImage, edge, 3, cv::Scalar(0, 255, 255), 1);
+            }
+        }
+
+        // イメージ格納
+        marker.image = resultImage(marker.bound).clone();
+    }
+}
+
+
+void MarkerTrackerEngine::buildPolygon(PolygonCache& cache, const std::vector<cv::Point>& contour, const cv::Point& center, const cv::Size& imageSize)
+{
+    // ポリゴン認識
+    std::vector<cv::Point> polygon;
+    cv::approxPolyDP(contour, polygon, 5, true);
+    std::reverse(polygon.begin(), polygon.end());
+
+    // 多すぎる場合はスキップ
+    cache.isValid = (polygon.size() <= 50);
+    if (!cache.isValid) return;
+
+    // 認識点群が角張っていることを利用して棄却
+    {
+        // 近い３点のなす角度が大きすぎる/小さすぎる場合、中心点を棄却
+        std::vector<cv::Point> filteredPolygon;
+        for (unsigned int i = 0; i < polygon.size(); ++i) {
+            const auto i1 = i;
+            const auto i2 = (i + 1) % polygon.size();
+            const auto i3 = (i + 2) % polygon.size();
+            const auto v1 = polygon[i2] - polygon[i1];
+            const auto v2 = polygon[i2] - polygon[i3];
+            const auto minLenThresh = imageSize.width * 0.03;
+            const auto angle = acos(abs(dot(normalize(cv::Point2d(v1)), normalize(cv::Point2d(v2)))));
+            const auto angleThresh = 0.2 * M_PI;
+            if ((angle < angleThresh) || (angle > M_PI - angleThresh)) {
+                ++i; // i2 をスキップ
+            } else if (len(v1) < minLenThresh && len(v2) < minLenThresh) {
+                ++i;
+            }
+            filteredPolygon.push_back(polygon[i1]);
+        }
+        polygon = filteredPolygon;
+    }
+    cache.polygon = polygon;
+
+    // 三角ポリゴン化
+    cache.indices = cache.triangulator.triangulate(polygon);
+
+    // 突端認識
+    cache.edges.clear();
+    if (polygon.size() >= 4) {
+        auto& edges = cache.edges;
+        const int N = polygon.size();
+        for (int i = 0; i < N; ++i) {
+            // 隣り合う 4 点
+            const int i0 = i;
+            const int i1 = ((i + 1) < N) ? (i + 1) : (i + 1 - N);
+            const int i2 = ((i + 2) < N) ? (i + 2) : (i + 2 - N);
+            const int i3 = ((i + 3) < N) ? (i + 3) : (i + 3 - N);
+            const auto v0 = polygon[i0];
+            const auto v1 = polygon[i1];
+            const auto v2 = polygon[i2];
+            const auto v3 = polygon[i3];
+
+            // 4 点を作る辺
+            const auto s1 = v1 - v0;
+            const auto s2 = v2 - v1;
+            const auto s3 = v3 - v2;
+            const auto l1 = len(s1);
+            const auto l2 = len(s2);
+            const auto l3 = len(s3);
+
+            // 4 点で囲まれる中心座標
+            const auto averagePos = (v0 + v1 + v2 + v3) * 0.25;
+            const double ratio = 0.4;
+
+            // 4 点の方向
+            // const auto dir = ((v1 + v2) - (v0 + v3)) * 0.5;
+            // 短い方を基点とする方向を求める
+            const auto dir = (l1 < l3) ? s1 : -s3;
+
+            // 認識範囲
+            const auto margin = 10;
+            const cv::Rect area(
+                cv::Point(margin, margin),
+                cv::Point(imageSize.width - margin, imageSize.height - margin));
+
+            // 中心の辺が短く、1 番目と 3 番目の辺が逆を向き、中心が白くて、
+            // 遠くにある場合、突端として認識する
+            const bool isMiddleShort     = (l1 != 0 && l2 / l1 < ratio) && (l3 != 0 && l2 / l3 < ratio);
+            const bool isOpposite        = s1.dot(s3) < -0.75;
+            const bool isAveragePosInner = cv::pointPolygonTest(polygon, averagePos, false) >= 0.0;
+            const bool isFar             = len((v1 + v2) * 0.5 - center) > 40;
+            const bool isMiddleMinLen    = len(s2) > 8;
+            const bool isNotNearBoundary = area.contains(v0) && area.contains(v1) && area.contains(v2) && area.contains(v3);
+            // qDebug() << isMiddleShort << " " << isOpposite << " " << isAveragePosInner << " " << isFar << " " << isMiddleMinLen;
+            if (isMiddleShort && isOpposite && isAveragePosInner && isFar && isMiddleMinLen && isNotNearBoundary) {
+                TrackedEdge edge((v1 + v2) * 0.5);
+                edge.direction = dir;
+                edges.push_back(edge);
+            }
+        }
+    }
+}
+
+
+void MarkerTrackerEngine::detectMotions(cv::Mat &resultImage, cv::Mat &inputImage)
+{
+    // 前フレームからの動きを、ArUco で見つからなかったマーカの中心・頂点・エッジだけ
+    // ピラミッド LK で追って求める（画面全体の動き履歴は持たない）
+    const cv::Mat preImage = preImage_;
+    preImage_ = inputImage;
+    if (preImage.empty() || preImage.size() != inputImage.size()) return;
+
+    // 全マーカの点をまとめて 1 回で追う
+    std::vector<TrackedMarker*> targets;
+    std::vector<int> offsets;
+    std::vector<cv::Point2f> prePoints;
+    for (auto&& marker : markers_) {
+        if (marker.checked) continue;
+        targets.push_back(&marker);
+        offsets.push_back(static_cast<int>(prePoints.size()));
+        prePoints.push_back(cv::Point2f(marker.x, marker.y));
+        for (const auto& vertex : marker.polygon) prePoints.push_back(vertex);
+        for (const auto& edge : marker.edges) prePoints.push_back(edge);
+    }
+    if (targets.empty()) return;
+    offsets.push_back(static_cast<int>(prePoints.size()));
+
+    // 往復で戻ってこない点（ブレや遮蔽）は捨てる
+    const cv::Size winSize(21, 21);
+    const int maxLevel = 3;
+    std::vector<cv::Point2f> points, backPoints;
+    std::vector<unsigned char> status, backStatus;
+    std::vector<float> errors;
+    cv::calcOpticalFlowPyrLK(preImage, inputImage, prePoints, points, status, errors, winSize, maxLevel);
+    cv::calcOpticalFlowPyrLK(inputImage, preImage, points, backPoints, backStatus, errors, winSize, maxLevel);
+
+    for (unsigned int t = 0; t < targets.size(); ++t) {
+        auto& marker = *targets[t];
+
+        std::vector<cv::Point2d> from, to;
+        for (int i = offsets[t]; i < offsets[t + 1]; ++i) {
+            if (!status[i] || !backStatus[i]) continue;
+            if (len(backPoints[i] - prePoints[i]) > 1.0) continue;
+            from.push_back(prePoints[i]);
+            to.push_back(points[i]);
+        }
+        if (from.empty()) continue;
+
+        // 重心を合わせ、残りの回転を最小二乗で求める（剛体変換）
+        const double n = static_cast<double>(from.size());
+        const auto fromCenter = std::accumulate(from.begin(), from.end(), cv::Point2d()) * (1.0 / n);
+        const auto toCenter   = std::accumulate(to.begin(),   to.end(),   cv::Point2d()) * (1.0 / n);
+        double sumDot = 0, sumCross = 0, spread = 0;
+        for (unsigned int i = 0; i < from.size(); ++i) {
+            const auto p = from[i] - fromCenter;
+            const auto q = to[i]   - toCenter;
+            sumDot   += dot(p, q);
+            sumCross += p.x * q.y - p.y * q.x;
+            spread   += dot(p, p);
+        }
+        // 点が固まっているときは回転が不安定なので平行移動だけ
+        const double theta = (spread > 100.0 * n) ? std::atan2(sumCross, sumDot) : 0.0;
+
+        // 当てはまりが悪ければ（一部だけ動いた・別の物体に乗り移った）使わない
+        double residual = 0;
+        for (unsigned int i = 0; i < from.size(); ++i) {
+            residual += len(rotate(from[i] - fromCenter, theta) + toCenter - to[i]);
+        }
+        if (residual / n > 2.0) continue;
+
+        const auto transform = [&](const cv::Point2d& pos) {
+            return rotate(pos - fromCenter, theta) + toCenter;
+        };
+
+        const cv::Point2d preCenter(marker.x, marker.y);
+        const auto center = transform(preCenter);
+        marker.x = center.x;
+        marker.y = center.y;
+        // 画面上で theta 回ると marker.angle は -theta 回る
+        marker.angle -= theta;
+        for (auto&& vertex : marker.polygon) {
+            vertex = transform(cv::Point2d(vertex));
+        }
+        for (auto&& edge : marker.edges) {
+            const cv::Point pos = transform(cv::Point2d(edge));
+            edge.x = pos.x;
+            edge.y = pos.y;
+            edge.direction = rotate(edge.direction, theta);
+        }
+
+        if (params_.isOutputImage) {
+            cv::arrowedLine(resultImage, preCenter, center, cv::Scalar(0, 0, 255), 3);
+        }
+    }
+}
+
+
+void MarkerTrackerEngine::detectPatterns(cv::Mat &resultImage, cv::Mat &inputImage)
+{
+    const auto width  = inputImage.cols;
+    const auto height = inputImage.rows;
+
+    for (auto&& marker : markers_) {
+        const auto& edges = marker.edges;
+        const auto pos     = cv::Point2d(marker.x, marker.y);
+        const auto forward = cv::Point2d(cos(-marker.angle), sin(-marker.angle));
+        const auto right   = cv::Point2d(cos(-marker.angle + M_PI / 2), sin(-marker.angle + M_PI / 2));
+        if (params_.isOutputImage) {
+            cv::arrowedLine(resultImage, pos, pos + forward * 30, cv::Scalar(255, 0, 255), 2);
+            cv::arrowedLine(resultImage, pos, pos + right   * 30, cv::Scalar(255, 255, 0), 2);
+        }
+
+        // エッジごとの特徴量を先に求めておき、組み合わせの判定は比較だけにする
+        const double parallelThresh = cos(M_PI / 6);
+        const double oppositeThresh = cos(M_PI / 4);
+        const double verticalThresh = cos(M_PI / 5);
+        std::vector<EdgeFeature> features;
+        for (const auto& edge : edges) {
+            if (!edge.activated) continue;
+
+            EdgeFeature feature;
+            feature.edge = &edge;
+            feature.pos  = toUnit<cv::Point2d>(edge, width, height);
+            feature.base = toUnit(cv::Point2d(edge) - edge.direction - pos, width, height);
+            feature.dir  = normalize(edge.direction);
+            feature.isBaseNearMarker = len(feature.base) < 0.35;
+
+            const auto forwardDot = dot(forward, feature.dir);
+            const auto rightDot   = dot(right,   feature.dir);
+            feature.forwardSign = sign(forwardDot);
+            feature.rightSign   = sign(rightDot);
+            feature.isForwardParallel = abs(forwardDot) > parallelThresh;
+            feature.isRightParallel   = abs(rightDot)   > parallelThresh;
+            feature.isForwardOpposite = abs(forwardDot) > oppositeThresh;
+            feature.isRightOpposite   = abs(rightDot)   > oppositeThresh;
+            feature.isForwardVertical = abs(forwardDot) > verticalThresh;
+            feature.isRightVertical   = abs(rightDot)   > verticalThresh;
+            features.push_back(feature);
+
+            if (params_.isOutputImage) {
+                cv::circle(resultImage, edge, 10, cv::Scalar(0, 0, 255), 2);
+                cv::circle(resultImage, cv::Point2d(edge) - edge.direction, 5, cv::Scalar(0, 0, 255), 2);
+            }
+        }
+
+        const int N = static_cast<int>(features.size());
+        if (N < 2) continue;
+
+        // 2 個からなるルール
+        // 組ごとの特徴をビットにまとめ、ルール表で判定する
+        struct Match
+        {
+            int a, b;
+            const PatternClassifier::Rule* rule;
+        };
+        std::vector<Match> matches;
+        for (int i = 0; i < N; ++i) {
+            for (int j = i + 1; j < N; ++j) {
+                const auto& a = features[i];
+                const auto& b = features[j];
+                const auto lenAB = len(a.pos - b.pos);
+
+                const bool isParallel =
+                    (a.isForwardParallel && b.isForwardParallel && a.forwardSign == b.forwardSign) ||
+                    (a.isRightParallel   && b.isRightParallel   && a.rightSign   == b.rightSign);
+                const bool isOpposite =
+                    (a.isForwardOpposite && b.isForwardOpposite && a.forwardSign != b.forwardSign) ||
+                    (a.isRightOpposite   && b.isRightOpposite   && a.rightSign   != b.rightSign);
+                const bool isVertical =
+                    (a.isForwardVertical && b.isRightVertical) ||
+                    (a.isRightVertical   && b.isForwardVertical);
+
+                const unsigned int pairFeatures =
+                    (isParallel ? PatternClassifier::Parallel : 0) |
+                    (isOpposite ? PatternClassifier::Opposite : 0) |
+                    (isVertical ? PatternClassifier::Vertical : 0) |
+                    ((lenAB >= 0.02 && lenAB < 0.15) ? PatternClassifier::Near : 0) |
+                    ((lenAB >= 0.15 && lenAB < 0.5)  ? PatternClassifier::Mid  : 0) |
+                    ((lenAB >= 0.50 && lenAB < 1.5)  ? PatternClassifier::Far  : 0) |
+                    ((len(a.base - b.base) < 0.2) ? PatternClassifier::BaseNear : 0) |
+                    ((a.isBaseNearMarker && b.isBaseNearMarker) ? PatternClassifier::BaseNearMarker : 0);
+
+                const auto* rule = classifier_->classify(pairFeatures);
+                if (!rule) continue;
+
+                Match match = { i, j, rule };
+                matches.push_back(match);
+            }
+        }
+
+        std::vector<TrackedPattern> patterns;
+        for (const auto& match : matches) {
+            TrackedPattern pattern;
+            pattern.edgeIds.push_back(features[match.a].edge->id);
+            pattern.edgeIds.push_back(features[match.b].edge->id);
+            pattern.pattern = match.rule->pattern;
+            patterns.push_back(pattern);
+        }
+        marker.patterns = patterns;
+
+        // 認識したパターンを描画
+        if (params_.isOutputImage) {
+            for (const auto& match : matches) {
+                const auto& edgeA = *features[match.a].edge;
+                const auto& edgeB = *features[match.b].edge;
+                const auto labelPos = (edgeA + edgeB) * 0.5 + cv::Point(features[match.a].dir * 10);
+                cv::line(resultImage, edgeA, edgeB, cv::Scalar(255, 0, 255), 1);
+                cv::putText(resultImage, match.rule->label, labelPos, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 255), 2, CV_AA);
+            }
+        }
+    }
+}
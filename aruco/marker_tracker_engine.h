@@ -0,0 +1,191 @@
+﻿#ifndef MARKER_TRACKER_ENGINE_H
+#define MARKER_TRACKER_ENGINE_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include "stage.h"
+#include "frame_averager.h"
+#include "polygon_triangulator.h"
+#include "pattern_classifier.h"
+
+
+namespace Littai
+{
+
+class TrackedEdge : public cv::Point
+{
+public:
+    TrackedEdge(const cv::Point& point)
+        : cv::Point(point)
+        , frameCount(0)
+        , lostCount(0)
+        , checked(false)
+        , activated(false)
+    {}
+    int id;
+    cv::Point2d direction;
+    cv::Point2d local;    // マーカを基準にした位置（マーカが回っても変わらない）
+    int frameCount;
+    int lostCount;
+    bool checked;
+    bool activated;
+
+    static int GetId()
+    {
+        return currentId++;
+    }
+
+private:
+    static int currentId;
+};
+
+
+struct TrackedPattern
+{
+    std::vector<int> edgeIds;
+    int pattern;
+};
+
+
+struct TrackedMarker
+{
+
+    unsigned int id;
+    double x, y;
+    double vx, vy;
+    double px, py;
+    std::chrono::system_clock::time_point t;
+    double angle;
+    double size;
+    int frameCount;
+    int lostCount;
+    bool checked;
+    cv::Rect bound;
+    std::vector<cv::Point> polygon;
+    std::vector<int> indices;
+    std::vector<TrackedEdge> edges;
+    std::vector<TrackedPattern> patterns;
+    cv::Mat image;
+
+    TrackedMarker()
+        : id(-1), x(0), y(0), vx(0), vy(0), px(0), py(0), angle(0)
+        , frameCount(0), lostCount(0), checked(false)
+    {
+    }
+
+    void update(const TrackedMarker& other)
+    {
+        x     = other.x;
+        y     = other.y;
+        angle = other.angle;
+        size  = other.size;
+    }
+
+    void print()
+    {
+        std::printf("id: %d  x: %.2f  y: %.2f  angle: %.2f  frame: %d\n",
+            id, x, y, angle, frameCount);
+    }
+};
+
+
+class MarkerTrackerEngine : public Stage
+{
+public:
+    struct Params
+    {
+        int contrastThreshold;
+        int contrastThresholdMin, contrastThresholdMax, contrastThresholdStep;
+        int fps;
+        int predictionFrame;
+        int averageFrames;    // 2 値化の前に平均するフレーム数（1 で無効）
+        bool isOutputImage;
+
+        Params()
+            : contrastThreshold(100)
+            , contrastThresholdMin(50), contrastThresholdMax(100), contrastThresholdStep(10)
+            , fps(30), predictionFrame(0), averageFrames(1), isOutputImage(true)
+        {
+        }
+    };
+
+    MarkerTrackerEngine();
+
+    void setParams(const Params& params);
+    Params params() const;
+    std::vector<TrackedMarker> markers() const;
+
+    // パターンのルール表（YAML）を読み込む。失敗したら今のルールのまま false を返す
+    bool loadPatterns(const std::string& path);
+
+    std::string name() const override;
+    void process(const cv::Mat& input, cv::Mat& output) override;
+
+private:
+    // マーカごとのポリゴン認識結果
+    // 止まっている駒は輪郭も変わらないので、前フレームの結果を平行移動して使い回す
+    struct PolygonCache
+    {
+        double x, y, angle;             // 作ったときのマーカの姿勢
+        unsigned long long checksum;    // 輪郭の形（先頭の点からの相対座標）のハッシュ
+        cv::Point origin;               // 輪郭の先頭の点
+        bool isValid;                   // 頂点が多すぎるものは false
+        std::vector<cv::Point> polygon;
+        std::vector<int> indices;
+        std::vector<TrackedEdge> edges; // 突端の候補（追跡前）
+        PolygonTriangulator triangulator;
+
+        PolygonCache()
+            : x(0), y(0), angle(0), checksum(0), isValid(false)
+        {
+        }
+    };
+
+    // パターン判定用のエッジの特徴量（マーカの前／右方向に対する向きの分類）
+    struct EdgeFeature
+    {
+        const TrackedEdge* edge;
+        cv::Point2d pos;          // 正規化した位置
+        cv::Point2d base;         // 柄の付け根（マーカ中心から、正規化）
+        cv::Point2d dir;
+        int forwardSign, rightSign;
+        bool isForwardParallel, isRightParallel;    // 30 度以内
+        bool isForwardOpposite, isRightOpposite;    // 45 度以内
+        bool isForwardVertical, isRightVertical;    // 36 度以内
+        bool isBaseNearMarker;
+    };
+
+    void preProcess(cv::Mat& image);
+    void detectMarkers(cv::Mat& resultImage, cv::Mat& inputImage);
+    void detectPolygons(cv::Mat& resultImage, cv::Mat& inputImage);
+    void buildPolygon(PolygonCache& cache, const std::vector<cv::Point>& contour, const cv::Point& center, const cv::Size& imageSize);
+    std::map<unsigned int, std::vector<cv::Point>> findMarkerRegions(const cv::Mat& image);
+    void detectMotions(cv::Mat& resultImage, cv::Mat& inputImage);
+    void detectPatterns(cv::Mat& resultImage, cv::Mat& inputImage);
+    void predictPosition();
+
+    mutable std::mutex mutex_;
+    Params nextParams_;
+    std::shared_ptr<const PatternClassifier> nextClassifier_;
+    std::vector<TrackedMarker> publishedMarkers_;
+
+    // 以下は処理スレッドだけが触る
+    Params params_;
+    std::shared_ptr<const PatternClassifier> classifier_;
+    FrameAverager averager_;
+    cv::Mat preImage_;
+    cv::Mat regionImage_, regionLabels_;
+    int frameCount_;
+
+    std::list<TrackedMarker> markers_;
+    std::map<unsigned int, PolygonCache> polygonCaches_;
+};
+
+}
+
+#endif // MARKER_TRACKER_ENGINE_H
@@ -0,0 +1,72 @@
+﻿#if defined _WIN32 || defined _WIN64
+#define _USE_MATH_DEFINES
+#endif
+
+#include "marker_variant.h"
+#include "mat_metatype.h"
+#include "vector_math.h"
+
+using namespace Littai;
+
+
+
+QVariantMap Littai::toVariantMap(const TrackedMarker& marker, int width, int height)
+{
+    QVariantMap o;
+    const auto markerPos = toUnit(cv::Point2d(marker.x, marker.y), width, height);
+    o.insert("id",         marker.id);
+    o.insert("x",          markerPos.x);
+    o.insert("y",          markerPos.y);
+    o.insert("size",       marker.size / ((width + height) / 2));
+    o.insert("angle",      marker.angle);
+    o.insert("frameCount", marker.frameCount);
+    o.insert("image",      QVariant::fromValue(marker.image));
+
+    QVariantList polygon, edges, indices, patterns;
+    for (const auto& vertex : marker.polygon) {
+        QVariantMap data;
+        const auto vertPos = toUnit(cv::Point2d(vertex.x, vertex.y), width, height);
+        const auto vertLocalPos = toLocal(vertPos, markerPos, marker.angle);
+        data.insert("x", vertLocalPos.x);
+        data.insert("y", vertLocalPos.y);
+
+        polygon.push_back(data);
+    }
+    for (const auto& edge : marker.edges) {
+        if (!edge.activated) continue;
+
+        QVariantMap data;
+        data.insert("id", edge.id);
+
+        const auto edgePos = toUnit(cv::Point2d(edge.x, edge.y), width, height);
+        const auto edgeLocalPos = toLocal(edgePos, markerPos, marker.angle);
+        data.insert("x", edgeLocalPos.x);
+        data.insert("y", edgeLocalPos.y);
+
+        QVariantMap direction;
+        const auto localDir = rotate(edge.direction, marker.angle);
+        direction.insert("x", localDir.x);
+        direction.insert("y", localDir.y);
+        data.insert("direction", direction);
+        edges.push_back(data);
+    }
+    for (int index : marker.indices) {
+        indices.push_back(index);
+    }
+    for (const auto& pattern : marker.patterns) {
+        QVariantMap data;
+        QVariantList ids;
+        for (const auto& id : pattern.edgeIds) {
+            ids.append(id);
+        }
+        data.insert("ids", ids);
+        data.insert("pattern", pattern.pattern);
+        patterns.push_back(data);
+    }
+    o.insert("polygon", polygon);
+    o.insert("edges", edges);
+    o.insert("indices", indices);
+    o.insert("patterns", patterns);
+
+    return o;
+}
@@ -0,0 +1,18 @@
+﻿#ifndef MARKER_VARIANT_H
+#define MARKER_VARIANT_H
+
+#include <QVariantMap>
+#include "marker_tracker_engine.h"
+
+
+namespace Littai
+{
+
+
+// QML / OSC に渡す形式に変換する（座標は -1 〜 1、形状はマーカのローカル座標）
+QVariantMap toVariantMap(const TrackedMarker& marker, int width, int height);
+
+
+}
+
+#endif // MARKER_VARIANT_H
@@ -0,0 +1,113 @@
+﻿#include <opencv2/opencv.hpp>
+#include "pattern_classifier.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    PatternClassifier::Rule makeRule(int pattern, const std::string& label, unsigned int required, unsigned int excluded, unsigned int anyOf)
+    {
+        PatternClassifier::Rule rule;
+        rule.pattern  = pattern;
+        rule.label    = label;
+        rule.required = required;
+        rule.excluded = excluded;
+        rule.anyOf    = anyOf;
+        return rule;
+    }
+
+
+    bool readFeatures(const cv::FileNode& node, unsigned int& mask)
+    {
+        mask = 0;
+        if (node.empty()) return true;
+        for (auto it = node.begin(); it != node.end(); ++it) {
+            const auto feature = PatternClassifier::featureFromName(static_cast<std::string>(*it));
+            if (feature == 0) return false;
+            mask |= feature;
+        }
+        return true;
+    }
+}
+
+
+
+PatternClassifier::PatternClassifier()
+{
+    // パターン 1：ある程度近い 2 点がマーカに対して垂直
+    rules_.push_back(makeRule(1, "A", Parallel, 0, Near));
+    // パターン 2：ある程度遠い 2 点がマーカに対して垂直
+    rules_.push_back(makeRule(2, "B", Parallel, 0, Mid | Far));
+    // パターン 3：柄がマーカに近接していない遠い 2 点がマーカに対して水平
+    rules_.push_back(makeRule(3, "C", Opposite | BaseNear, BaseNearMarker, Mid | Far));
+    // パターン 4：マーカに対して L 字になる感じ
+    rules_.push_back(makeRule(4, "D", Vertical, 0, Mid | Far));
+    // パターン 5：柄がマーカに近接した遠い 2 点がマーカに対して水平
+    rules_.push_back(makeRule(5, "E", Opposite, 0, Mid | Far));
+}
+
+
+bool PatternClassifier::load(const std::string& path)
+{
+    std::vector<Rule> rules;
+    try {
+        cv::FileStorage fs(path, cv::FileStorage::READ);
+        if (!fs.isOpened()) return false;
+
+        const auto patterns = fs["patterns"];
+        if (patterns.type() != cv::FileNode::SEQ) return false;
+
+        for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+            const auto node = *it;
+            Rule rule;
+            rule.pattern = static_cast<int>(node["id"]);
+            rule.label   = static_cast<std::string>(node["label"]);
+            if (!readFeatures(node["require"], rule.required) ||
+                !readFeatures(node["exclude"], rule.excluded) ||
+                !readFeatures(node["anyOf"],   rule.anyOf)) {
+                return false;
+            }
+            rules.push_back(rule);
+        }
+    } catch (const cv::Exception&) {
+        return false;
+    }
+
+    rules_.swap(rules);
+    return true;
+}
+
+
+const std::vector<PatternClassifier::Rule>& PatternClassifier::rules() const
+{
+    return rules_;
+}
+
+
+const PatternClassifier::Rule* PatternClassifier::classify(unsigned int features) const
+{
+    for (const auto& rule : rules_) {
+        const bool isMatched =
+            (features & rule.required) == rule.required &&
+            (features & rule.excluded) == 0 &&
+            (rule.anyOf == 0 || (features & rule.anyOf) != 0);
+        if (isMatched) return &rule;
+    }
+    return nullptr;
+}
+
+
+unsigned int PatternClassifier::featureFromName(const std::string& name)
+{
+    if (name == "parallel")       return Parallel;
+    if (name == "opposite")       return Opposite;
+    if (name == "vertical")       return Vertical;
+    if (name == "near")           return Near;
+    if (name == "mid")            return Mid;
+    if (name == "far")            return Far;
+    if (name == "baseNear")       return BaseNear;
+    if (name == "baseNearMarker") return BaseNearMarker;
+    return 0;
+}
@@ -0,0 +1,58 @@
+﻿#ifndef PATTERN_CLASSIFIER_H
+#define PATTERN_CLASSIFIER_H
+
+#include <string>
+#include <vector>
+
+
+namespace Littai
+{
+
+
+// エッジ 2 つの配置から駒のパターンを判定する（Qt に依存しない）
+// ルールは特徴のビットマスクに変換しておき、判定はマスクの比較だけで行う
+// ルール表は YAML（cv::FileStorage 形式）から読み込める。読み込まなければ A - E の既定のルール
+class PatternClassifier
+{
+public:
+    // エッジの組の幾何的な特徴
+    enum Feature
+    {
+        Parallel       = 1 << 0,   // 2 つともマーカの前（または右）を同じ向きに向いている
+        Opposite       = 1 << 1,   // 2 つともマーカの前（または右）に沿って逆を向いている
+        Vertical       = 1 << 2,   // 一方が前、他方が右を向いている
+        Near           = 1 << 3,   // エッジ間の距離（正規化座標で 0.02 - 0.15）
+        Mid            = 1 << 4,   // 0.15 - 0.5
+        Far            = 1 << 5,   // 0.5 - 1.5
+        BaseNear       = 1 << 6,   // 柄の付け根どうしが近い
+        BaseNearMarker = 1 << 7    // 柄の付け根が 2 つともマーカに近い
+    };
+
+    struct Rule
+    {
+        int pattern;
+        std::string label;
+        unsigned int required;   // すべて満たす
+        unsigned int excluded;   // どれも満たさない
+        unsigned int anyOf;      // どれか 1 つを満たす（0 なら条件なし）
+    };
+
+    PatternClassifier();
+
+    // 失敗したときはルールを変えずに false を返す
+    bool load(const std::string& path);
+    const std::vector<Rule>& rules() const;
+
+    // 表の順で最初に当てはまったルール（無ければ nullptr）
+    const Rule* classify(unsigned int features) const;
+
+    static unsigned int featureFromName(const std::string& name);
+
+private:
+    std::vector<Rule> rules_;
+};
+
+
+}
+
+#endif // PATTERN_CLASSIFIER_H
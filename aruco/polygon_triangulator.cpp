@@ -0,0 +1,123 @@
+﻿#include <cstdlib>
+#include "polygon_triangulator.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // (b - a) x (c - b)
+    long long cross(const cv::Point& a, const cv::Point& b, const cv::Point& c)
+    {
+        return static_cast<long long>(b.x - a.x) * (c.y - b.y) - static_cast<long long>(b.y - a.y) * (c.x - b.x);
+    }
+}
+
+
+
+PolygonTriangulator::PolygonTriangulator()
+    : tolerance_(1)
+{
+}
+
+
+void PolygonTriangulator::setTolerance(int tolerance)
+{
+    tolerance_ = tolerance;
+}
+
+
+const std::vector<int>& PolygonTriangulator::triangulate(const std::vector<cv::Point>& polygon)
+{
+    if (isUnchanged(polygon)) {
+        return indices_;
+    }
+    polygon_ = polygon;
+    indices_.clear();
+
+    const int n = static_cast<int>(polygon.size());
+    if (n < 3) return indices_;
+
+    // 向き（符号付き面積の符号）
+    long long area = 0;
+    for (int i = 0; i < n; ++i) {
+        const auto& p = polygon[i];
+        const auto& q = polygon[(i + 1) % n];
+        area += static_cast<long long>(p.x) * q.y - static_cast<long long>(q.x) * p.y;
+    }
+    const int orientation = (area >= 0) ? 1 : -1;
+
+    // 頂点番号のリング
+    prev_.resize(n);
+    next_.resize(n);
+    for (int i = 0; i < n; ++i) {
+        prev_[i] = (i + n - 1) % n;
+        next_[i] = (i + 1) % n;
+    }
+
+    int remaining = n;
+    int i = 0;
+    int miss = 0;
+    while (remaining > 3) {
+        // 一周しても耳が見つからない（自己交差など）ときはそのまま切り落として進める
+        if (isEar(polygon, i, orientation) || miss > remaining) {
+            indices_.push_back(prev_[i]);
+            indices_.push_back(i);
+            indices_.push_back(next_[i]);
+
+            next_[prev_[i]] = next_[i];
+            prev_[next_[i]] = prev_[i];
+            --remaining;
+            miss = 0;
+            i = next_[i];
+        } else {
+            ++miss;
+            i = next_[i];
+        }
+    }
+    indices_.push_back(prev_[i]);
+    indices_.push_back(i);
+    indices_.push_back(next_[i]);
+
+    return indices_;
+}
+
+
+bool PolygonTriangulator::isUnchanged(const std::vector<cv::Point>& polygon) const
+{
+    if (polygon.size() != polygon_.size() || polygon.empty()) return false;
+
+    for (unsigned int i = 0; i < polygon.size(); ++i) {
+        if (std::abs(polygon[i].x - polygon_[i].x) > tolerance_ ||
+            std::abs(polygon[i].y - polygon_[i].y) > tolerance_) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool PolygonTriangulator::isEar(const std::vector<cv::Point>& polygon, int i, int orientation) const
+{
+    const int ia = prev_[i];
+    const int ic = next_[i];
+    const auto& a = polygon[ia];
+    const auto& b = polygon[i];
+    const auto& c = polygon[ic];
+
+    // 凸でなければ耳ではない
+    if (cross(a, b, c) * orientation <= 0) return false;
+
+    // 残りの頂点が三角形の中（辺上を含む）にあれば耳ではない
+    for (int j = next_[ic]; j != ia; j = next_[j]) {
+        const auto& p = polygon[j];
+        if (p == a || p == b || p == c) continue;
+        if (cross(a, b, p) * orientation >= 0 &&
+            cross(b, c, p) * orientation >= 0 &&
+            cross(c, a, p) * orientation >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+﻿#ifndef POLYGON_TRIANGULATOR_H
+#define POLYGON_TRIANGULATOR_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+
+namespace Littai
+{
+
+
+// 単純多角形を耳刈り取り法で三角形に分割する（Qt に依存しない）
+// 頂点の番号を並べたリング上で耳を切り落とし、頂点番号の 3 つ組をそのまま出力する
+// バッファは使い回すので、頂点数が増えない限り呼び出しごとの確保は起きない
+class PolygonTriangulator
+{
+public:
+    PolygonTriangulator();
+
+    // 前回と頂点数が同じで、各頂点の移動が tolerance 以内なら前回の結果を返す
+    void setTolerance(int tolerance);
+
+    // 3 つずつ並んだ頂点番号（時計回り・反時計回りどちらの入力でもよい）
+    const std::vector<int>& triangulate(const std::vector<cv::Point>& polygon);
+
+private:
+    bool isUnchanged(const std::vector<cv::Point>& polygon) const;
+    bool isEar(const std::vector<cv::Point>& polygon, int i, int orientation) const;
+
+    int tolerance_;
+    std::vector<cv::Point> polygon_;
+    std::vector<int> indices_;
+    std::vector<int> prev_, next_;
+};
+
+
+}
+
+#endif // POLYGON_TRIANGULATOR_H
@@ -0,0 +1,30 @@
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+TARGET = littai_bench
+
+QT = core
+
+SOURCES += \
+    main.cpp \
+    stage_profiler.cpp \
+    synthetic_scene.cpp \
+    ground_truth.cpp
+
+HEADERS += \
+    stage_profiler.h \
+    synthetic_scene.h \
+    ground_truth.h
+
+win32 {
+    QMAKE_CXXFLAGS_RELEASE -= -O
+    QMAKE_CXXFLAGS_RELEASE -= -O1
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_CXXFLAGS_RELEASE *= -O3
+}
+
+include(../opencv/opencv_core.pri)
+include(../aruco/aruco_core.pri)
+include(../pipeline/pipeline_core.pri)
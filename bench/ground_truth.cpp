@@ -0,0 +1,127 @@
+﻿#if defined _WIN32 || defined _WIN64
+#define _USE_MATH_DEFINES
+#endif
+
+#include <cmath>
+#include <iomanip>
+#include "ground_truth.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    double angleDifference(double a, double b)
+    {
+        auto d = std::fmod(a - b, 2 * M_PI);
+        if (d >  M_PI) d -= 2 * M_PI;
+        if (d < -M_PI) d += 2 * M_PI;
+        return std::abs(d);
+    }
+}
+
+
+
+void GroundTruthEvaluator::Stats::add(const SceneObject& truth, double x, double y, double truthAngle, double angle)
+{
+    const double dx = x - truth.position.x;
+    const double dy = y - truth.position.y;
+    ++found;
+    positionError += std::sqrt(dx * dx + dy * dy);
+    angleError    += angleDifference(angle, truthAngle);
+}
+
+
+
+// ---
+
+
+
+GroundTruthEvaluator::GroundTruthEvaluator(double landoltMatchDistance)
+    : landoltMatchDistance_(landoltMatchDistance)
+{
+}
+
+
+void GroundTruthEvaluator::evaluateMarkers(const std::vector<SceneObject>& truth, const std::vector<TrackedMarker>& markers)
+{
+    // マーカは ID で対応付ける（このフレームで見えていないものは数えない）
+    markerStats_.expected += static_cast<int>(truth.size());
+    for (const auto& marker : markers) {
+        if (marker.lostCount > 0) continue;
+
+        bool isFound = false;
+        for (const auto& object : truth) {
+            if (static_cast<int>(marker.id) == object.id) {
+                markerStats_.add(object, marker.x, marker.y, object.markerAngle(), marker.angle);
+                isFound = true;
+                break;
+            }
+        }
+        if (!isFound) {
+            ++markerStats_.falsePositives;
+        }
+    }
+}
+
+
+void GroundTruthEvaluator::evaluateLandolts(const std::vector<SceneObject>& truth, const std::vector<TrackedItem>& items)
+{
+    // ランドルト環は ID を持たないので一番近いものと対応付ける
+    landoltStats_.expected += static_cast<int>(truth.size());
+    std::vector<bool> isUsed(truth.size(), false);
+    for (const auto& item : items) {
+        if (item.lostCount > 0) continue;
+
+        int nearest = -1;
+        double nearestDistance = landoltMatchDistance_;
+        for (unsigned int i = 0; i < truth.size(); ++i) {
+            if (isUsed[i]) continue;
+            const double dx = item.x - truth[i].position.x;
+            const double dy = item.y - truth[i].position.y;
+            const double distance = std::sqrt(dx * dx + dy * dy);
+            if (distance < nearestDistance) {
+                nearest = i;
+                nearestDistance = distance;
+            }
+        }
+        if (nearest < 0) {
+            ++landoltStats_.falsePositives;
+            continue;
+        }
+        isUsed[nearest] = true;
+        landoltStats_.add(truth[nearest], item.x, item.y, truth[nearest].landoltAngle(), item.angle);
+    }
+}
+
+
+void GroundTruthEvaluator::printRow(std::ostream& os, const char* name, const Stats& stats)
+{
+    const double recall = stats.expected > 0 ? 100.0 * stats.found / stats.expected : 0.0;
+    const double positionError = stats.found > 0 ? stats.positionError / stats.found : 0.0;
+    const double angleError    = stats.found > 0 ? stats.angleError / stats.found * 180 / M_PI : 0.0;
+    os << std::left  << std::setw(12) << name
+       << std::right << std::setw(10) << stats.expected
+       << std::fixed << std::setprecision(1)
+       << std::setw(10) << recall
+       << std::setw(10) << stats.falsePositives
+       << std::setprecision(2)
+       << std::setw(12) << positionError
+       << std::setw(12) << angleError
+       << std::endl;
+}
+
+
+void GroundTruthEvaluator::print(std::ostream& os) const
+{
+    os << std::left  << std::setw(12) << "target"
+       << std::right << std::setw(10) << "expected"
+       << std::setw(10) << "found %"
+       << std::setw(10) << "false+"
+       << std::setw(12) << "pos err px"
+       << std::setw(12) << "angle deg"
+       << std::endl;
+    printRow(os, "marker",  markerStats_);
+    printRow(os, "landolt", landoltStats_);
+}
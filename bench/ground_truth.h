@@ -0,0 +1,49 @@
+﻿#ifndef GROUND_TRUTH_H
+#define GROUND_TRUTH_H
+
+#include <ostream>
+#include <vector>
+#include "synthetic_scene.h"
+#include "marker_tracker_engine.h"
+#include "landolt_tracker_engine.h"
+
+
+namespace Littai
+{
+
+
+// 合成シーンの真値とトラッカーの出力を比べて精度を集計する
+class GroundTruthEvaluator
+{
+public:
+    explicit GroundTruthEvaluator(double landoltMatchDistance);
+
+    void evaluateMarkers(const std::vector<SceneObject>& truth, const std::vector<TrackedMarker>& markers);
+    void evaluateLandolts(const std::vector<SceneObject>& truth, const std::vector<TrackedItem>& items);
+    void print(std::ostream& os) const;
+
+private:
+    struct Stats
+    {
+        int expected, found, falsePositives;
+        double positionError, angleError;
+
+        Stats()
+            : expected(0), found(0), falsePositives(0)
+            , positionError(0.0), angleError(0.0)
+        {
+        }
+
+        void add(const SceneObject& truth, double x, double y, double truthAngle, double angle);
+    };
+
+    static void printRow(std::ostream& os, const char* name, const Stats& stats);
+
+    double landoltMatchDistance_;
+    Stats markerStats_, landoltStats_;
+};
+
+
+}
+
+#endif // GROUND_TRUTH_H
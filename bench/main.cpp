@@ -0,0 +1,297 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStringList>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <chrono>
+
+#include "frame_source.h"
+#include "stage_profiler.h"
+#include "synthetic_scene.h"
+#include "ground_truth.h"
+#include "homography_engine.h"
+#include "diff_image_engine.h"
+#include "landolt_tracker_engine.h"
+#include "marker_tracker_engine.h"
+#include "pipeline_graph.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    template <class F>
+    double measure(F func)
+    {
+        using namespace std::chrono;
+        const auto t1 = high_resolution_clock::now();
+        func();
+        const auto t2 = high_resolution_clock::now();
+        return duration_cast<microseconds>(t2 - t1).count() / 1000.0;
+    }
+
+    bool parsePoints(const QString& text, std::vector<cv::Point2d>& points)
+    {
+        const auto values = text.split(',');
+        if (values.size() != 8) return false;
+        for (int i = 0; i < 4; ++i) {
+            points.push_back(cv::Point2d(values[2 * i].toDouble(), values[2 * i + 1].toDouble()));
+        }
+        return true;
+    }
+}
+
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("littai_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the LITTAI tracking pipeline headlessly and reports per-stage latency.");
+    parser.addHelpOption();
+
+    const QCommandLineOption replayOption("replay", "Recorded frame file to run.", "file");
+    const QCommandLineOption imageOption("image", "Still image to run repeatedly.", "file");
+    const QCommandLineOption syntheticOption("synthetic", "Render a synthetic scene with known marker and Landolt poses and score the trackers.");
+    const QCommandLineOption baseOption("base", "Base image for the diff stage, or 'first' to use the first frame.", "file");
+    const QCommandLineOption templateOption("template", "Landolt template image. The Landolt tracker is skipped without it.", "file");
+    const QCommandLineOption matchMethodOption("match-method", "Landolt template matching: auto, spatial or fft.", "method", "auto");
+    const QCommandLineOption homographyOption("homography", "Normalized source corners x0,y0,x1,y1,x2,y2,x3,y3.", "points");
+    const QCommandLineOption sizeOption("size", "Homography output size.", "pixels", "480");
+    const QCommandLineOption framesOption("frames", "Number of measured frames.", "count", "300");
+    const QCommandLineOption warmupOption("warmup", "Frames run before measuring.", "count", "10");
+    const QCommandLineOption pipelineOption("pipeline", "Overlap stages across frames with this many frames in flight and report throughput.", "count");
+    const QCommandLineOption threadsOption("threads", "Worker threads for --pipeline.", "count", "8");
+    const QCommandLineOption markersOption("markers", "Synthetic: number of markers.", "count", "4");
+    const QCommandLineOption landoltsOption("landolts", "Synthetic: number of Landolt rings.", "count", "4");
+    const QCommandLineOption markerSizeOption("marker-size", "Synthetic: marker side length.", "pixels", "24");
+    const QCommandLineOption landoltSizeOption("landolt-size", "Synthetic: Landolt ring diameter.", "pixels", "48");
+    const QCommandLineOption speedOption("speed", "Synthetic: object speed.", "pixels/frame", "0");
+    const QCommandLineOption rotationOption("rotation", "Synthetic: object angular speed.", "degrees/frame", "0");
+    const QCommandLineOption blurOption("blur", "Synthetic: subframes averaged per frame for motion blur.", "count", "1");
+    const QCommandLineOption noiseOption("noise", "Synthetic: standard deviation of Gaussian noise.", "level", "0");
+    const QCommandLineOption falloffOption("falloff", "Synthetic: IR falloff towards the corners (0-1).", "ratio", "0");
+    const QCommandLineOption seedOption("seed", "Synthetic: random seed for placement and noise.", "seed", "0");
+    parser.addOption(replayOption);
+    parser.addOption(imageOption);
+    parser.addOption(syntheticOption);
+    parser.addOption(markersOption);
+    parser.addOption(landoltsOption);
+    parser.addOption(markerSizeOption);
+    parser.addOption(landoltSizeOption);
+    parser.addOption(speedOption);
+    parser.addOption(rotationOption);
+    parser.addOption(blurOption);
+    parser.addOption(noiseOption);
+    parser.addOption(falloffOption);
+    parser.addOption(seedOption);
+    parser.addOption(baseOption);
+    parser.addOption(templateOption);
+    parser.addOption(matchMethodOption);
+    parser.addOption(homographyOption);
+    parser.addOption(sizeOption);
+    parser.addOption(framesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(pipelineOption);
+    parser.addOption(threadsOption);
+    parser.process(app);
+
+    // 入力
+    std::shared_ptr<FrameSource> source;
+    std::shared_ptr<SyntheticScene> scene;
+    if (parser.isSet(syntheticOption)) {
+        SyntheticScene::Params params;
+        params.markerCount  = parser.value(markersOption).toInt();
+        params.landoltCount = parser.value(landoltsOption).toInt();
+        params.markerSize   = parser.value(markerSizeOption).toDouble();
+        params.landoltSize  = parser.value(landoltSizeOption).toDouble();
+        params.speed        = parser.value(speedOption).toDouble();
+        params.angularSpeed = parser.value(rotationOption).toDouble();
+        params.blurSamples  = parser.value(blurOption).toInt();
+        params.noise        = parser.value(noiseOption).toDouble();
+        params.falloff      = parser.value(falloffOption).toDouble();
+        params.seed         = parser.value(seedOption).toUInt();
+        const int size = parser.value(sizeOption).toInt();
+        params.size = cv::Size(size, size);
+        scene = std::make_shared<SyntheticScene>(params);
+        source = scene;
+    } else if (parser.isSet(replayOption)) {
+        source = std::make_shared<ReplaySource>(parser.value(replayOption).toStdString());
+    } else if (parser.isSet(imageOption)) {
+        source = std::make_shared<StillImageSource>(parser.value(imageOption).toStdString());
+    }
+    if (!source || !source->isValid()) {
+        std::cerr << "no valid input. use --replay, --image or --synthetic." << std::endl;
+        return 1;
+    }
+
+    // ステージ
+    HomographyEngine homography;
+    if (parser.isSet(homographyOption)) {
+        std::vector<cv::Point2d> points;
+        if (!parsePoints(parser.value(homographyOption), points)) {
+            std::cerr << "--homography needs 8 comma separated values." << std::endl;
+            return 1;
+        }
+        homography.setSrcPoints(points);
+        const int size = parser.value(sizeOption).toInt();
+        homography.setOutputSize(size, size);
+    }
+
+    DiffImageEngine diff;
+    const auto basePath = parser.value(baseOption);
+    bool isBaseFromFirstFrame = (basePath == "first");
+    if (!basePath.isEmpty() && !isBaseFromFirstFrame) {
+        const auto baseImage = cv::imread(basePath.toStdString());
+        if (baseImage.empty()) {
+            std::cerr << basePath.toStdString() << " is not found." << std::endl;
+            return 1;
+        }
+        diff.setBaseImage(baseImage);
+    } else if (basePath.isEmpty() && scene) {
+        // 合成シーンでは物体のない背景が分かっている
+        diff.setBaseImage(scene->backgroundImage());
+    }
+
+    MarkerTrackerEngine markerTracker;
+
+    std::shared_ptr<LandoltTrackerEngine> landoltTracker;
+    if (parser.isSet(templateOption)) {
+        const auto templateImage = cv::imread(parser.value(templateOption).toStdString());
+        if (templateImage.empty()) {
+            std::cerr << parser.value(templateOption).toStdString() << " is not found." << std::endl;
+            return 1;
+        }
+        landoltTracker = std::make_shared<LandoltTrackerEngine>();
+        landoltTracker->setTemplateImage(templateImage);
+    } else if (scene && scene->params().landoltCount > 0) {
+        landoltTracker = std::make_shared<LandoltTrackerEngine>();
+        landoltTracker->setTemplateImage(scene->templateImage());
+    }
+    if (landoltTracker) {
+        auto params = landoltTracker->params();
+        params.matchMethod = TemplateMatcher::methodFromName(parser.value(matchMethodOption).toStdString());
+        landoltTracker->setParams(params);
+    }
+
+    // 計測
+    const int frames = parser.value(framesOption).toInt();
+    const int warmup = parser.value(warmupOption).toInt();
+
+    // ステージをフレームごとにずらして並列に流したときのスループット
+    if (parser.isSet(pipelineOption)) {
+        const int maxInFlight = parser.value(pipelineOption).toInt();
+        PipelineGraph graph;
+        graph.setMaxInFlight(maxInFlight);
+        graph.setQueueCapacity(maxInFlight);
+        graph.addNode(homography.name(), homography, "", nullptr);
+        graph.addNode(diff.name(), diff, homography.name(), nullptr);
+        graph.addNode(markerTracker.name(), markerTracker, diff.name(), nullptr);
+        if (landoltTracker) {
+            graph.addNode(landoltTracker->name(), *landoltTracker, diff.name(), nullptr);
+        }
+        graph.start(parser.value(threadsOption).toInt());
+
+        auto pushFrames = [&](int count) {
+            for (int i = 0; i < count; ++i) {
+                // グラフの中のフレームと共有されるので毎回新しいバッファに読む
+                cv::Mat frame;
+                if (!source->next(frame)) break;
+                if (isBaseFromFirstFrame) {
+                    cv::Mat baseImage;
+                    homography.process(frame, baseImage);
+                    diff.setBaseImage(baseImage);
+                    isBaseFromFirstFrame = false;
+                }
+                graph.push(frame);
+            }
+            graph.waitForIdle();
+        };
+
+        pushFrames(warmup);
+        const auto before = graph.stats();
+        const double totalMs = measure([&] { pushFrames(frames); });
+        const auto after = graph.stats();
+        graph.stop();
+
+        std::cout << std::left  << std::setw(12) << "stage"
+                  << std::right << std::setw(8)  << "n"
+                  << std::setw(10) << "mean"
+                  << std::setw(10) << "max"
+                  << std::setw(10) << "dropped" << std::endl;
+        for (unsigned int i = 0; i < after.nodes.size(); ++i) {
+            const auto& a = after.nodes[i];
+            const auto& b = before.nodes[i];
+            const int n = a.count - b.count;
+            std::cout << std::left  << std::setw(12) << a.name
+                      << std::right << std::setw(8)  << n
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(10) << (n > 0 ? (a.totalMs - b.totalMs) / n : 0.0)
+                      << std::setw(10) << a.maxMs
+                      << std::setw(10) << (a.dropped - b.dropped) << std::endl;
+        }
+        const int completed = after.completed - before.completed;
+        std::cout << std::endl
+                  << "in flight " << maxInFlight << ": "
+                  << completed << " frames in " << std::setprecision(1) << totalMs << " ms ("
+                  << (totalMs > 0 ? completed * 1000.0 / totalMs : 0.0) << " fps)" << std::endl;
+        if (landoltTracker) {
+            std::cout << "landolt match: " << landoltTracker->matchMethod() << std::endl;
+        }
+        return 0;
+    }
+
+    StageProfiler profiler;
+    GroundTruthEvaluator evaluator(scene ? scene->params().landoltSize / 2 : 0.0);
+    cv::Mat frame, homographyImage, diffImage, markerImage, landoltImage;
+
+    for (int i = 0; i < warmup + frames; ++i) {
+        if (!source->next(frame)) break;
+
+        const bool isMeasured = (i >= warmup);
+        double ms;
+        const double frameMs = measure([&] {
+            ms = measure([&] { homography.process(frame, homographyImage); });
+            if (isMeasured) profiler.add(homography.name(), ms);
+
+            if (isBaseFromFirstFrame) {
+                diff.setBaseImage(homographyImage);
+                isBaseFromFirstFrame = false;
+            }
+            ms = measure([&] { diff.process(homographyImage, diffImage); });
+            if (isMeasured) profiler.add(diff.name(), ms);
+
+            ms = measure([&] { markerTracker.process(diffImage, markerImage); });
+            if (isMeasured) profiler.add(markerTracker.name(), ms);
+
+            if (landoltTracker) {
+                ms = measure([&] { landoltTracker->process(diffImage, landoltImage); });
+                if (isMeasured) profiler.add(landoltTracker->name(), ms);
+            }
+        });
+        if (isMeasured) profiler.addFrame(frameMs);
+
+        // 精度は時間計測の外で評価する
+        if (isMeasured && scene) {
+            evaluator.evaluateMarkers(scene->markers(), markerTracker.markers());
+            if (landoltTracker) {
+                evaluator.evaluateLandolts(scene->landolts(), landoltTracker->items());
+            }
+        }
+    }
+
+    profiler.print(std::cout);
+    if (landoltTracker) {
+        std::cout << "landolt match: " << landoltTracker->matchMethod() << std::endl;
+    }
+    if (scene) {
+        std::cout << std::endl;
+        evaluator.print(std::cout);
+    }
+
+    return 0;
+}
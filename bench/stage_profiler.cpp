@@ -0,0 +1,76 @@
+﻿#include <algorithm>
+#include <numeric>
+#include <iomanip>
+#include "stage_profiler.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    double percentile(std::vector<double> samples, double p)
+    {
+        if (samples.empty()) return 0.0;
+        std::sort(samples.begin(), samples.end());
+        const auto index = static_cast<std::size_t>(p * (samples.size() - 1) + 0.5);
+        return samples[index];
+    }
+
+    double mean(const std::vector<double>& samples)
+    {
+        if (samples.empty()) return 0.0;
+        return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    }
+
+    void printRow(std::ostream& os, const std::string& name, const std::vector<double>& samples)
+    {
+        const auto average = mean(samples);
+        os << std::left  << std::setw(12) << name
+           << std::right << std::setw(8)  << samples.size()
+           << std::fixed << std::setprecision(3)
+           << std::setw(10) << average
+           << std::setw(10) << percentile(samples, 0.5)
+           << std::setw(10) << percentile(samples, 0.95)
+           << std::setw(10) << (samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()))
+           << std::setprecision(1)
+           << std::setw(10) << (average > 0.0 ? 1000.0 / average : 0.0)
+           << std::endl;
+    }
+}
+
+
+
+void StageProfiler::add(const std::string& stage, double ms)
+{
+    auto it = samples_.find(stage);
+    if (it == samples_.end()) {
+        stages_.push_back(stage);
+        it = samples_.insert(std::make_pair(stage, std::vector<double>())).first;
+    }
+    it->second.push_back(ms);
+}
+
+
+void StageProfiler::addFrame(double ms)
+{
+    frames_.push_back(ms);
+}
+
+
+void StageProfiler::print(std::ostream& os) const
+{
+    os << std::left  << std::setw(12) << "stage"
+       << std::right << std::setw(8)  << "n"
+       << std::setw(10) << "mean ms"
+       << std::setw(10) << "p50 ms"
+       << std::setw(10) << "p95 ms"
+       << std::setw(10) << "max ms"
+       << std::setw(10) << "fps"
+       << std::endl;
+
+    for (const auto& stage : stages_) {
+        printRow(os, stage, samples_.at(stage));
+    }
+    printRow(os, "total", frames_);
+}
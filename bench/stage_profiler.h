@@ -0,0 +1,31 @@
+﻿#ifndef STAGE_PROFILER_H
+#define STAGE_PROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+namespace Littai
+{
+
+
+// ステージごとの処理時間 (ms) を集めて統計を出す
+class StageProfiler
+{
+public:
+    void add(const std::string& stage, double ms);
+    void addFrame(double ms);
+    void print(std::ostream& os) const;
+
+private:
+    std::vector<std::string> stages_;
+    std::map<std::string, std::vector<double>> samples_;
+    std::vector<double> frames_;
+};
+
+
+}
+
+#endif // STAGE_PROFILER_H
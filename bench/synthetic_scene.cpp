@@ -0,0 +1,306 @@
+﻿#if defined _WIN32 || defined _WIN64
+#pragma warning( disable : 4290 )
+#define _USE_MATH_DEFINES
+#endif
+
+#include <cmath>
+#include <algorithm>
+#include <aruco.h>
+#include "synthetic_scene.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // IR 画像での背景と物体の明るさ
+    const unsigned char backgroundLevel = 30;
+    const unsigned char objectLevel     = 230;
+
+    double wrapAngle(double angle)
+    {
+        angle = std::fmod(angle, 2 * M_PI);
+        return (angle < 0) ? angle + 2 * M_PI : angle;
+    }
+
+    // 中心から +x 方向に切れ目のあるランドルト環
+    void drawLandolt(cv::Mat& image, double diameter, unsigned char level)
+    {
+        const int shift = 4;
+        const double scale = 1 << shift;
+        const cv::Point2d center((image.cols - 1) / 2.0, (image.rows - 1) / 2.0);
+        const double radius    = diameter / 2;
+        const double thickness = diameter / 5;
+
+        cv::circle(
+            image,
+            cv::Point(cvRound(center.x * scale), cvRound(center.y * scale)),
+            cvRound((radius - thickness / 2) * scale),
+            cv::Scalar(level),
+            std::max(1, cvRound(thickness)),
+            CV_AA,
+            shift);
+
+        const cv::Point gap[] = {
+            cv::Point(cvRound(center.x),              cvRound(center.y - thickness / 2)),
+            cv::Point(cvRound(center.x + radius + 2), cvRound(center.y - thickness / 2)),
+            cv::Point(cvRound(center.x + radius + 2), cvRound(center.y + thickness / 2)),
+            cv::Point(cvRound(center.x),              cvRound(center.y + thickness / 2)),
+        };
+        cv::fillConvexPoly(image, gap, 4, cv::Scalar(0));
+    }
+}
+
+
+
+double SceneObject::markerAngle() const
+{
+    // MarkerTracker と同じく 0 番と 3 番の角を結ぶ辺から求める
+    const double a = rotation * M_PI / 180;
+    const cv::Point2d side(-std::sin(a), -std::cos(a));
+    return std::atan2(side.x, side.y);
+}
+
+
+double SceneObject::landoltAngle() const
+{
+    // cv::getRotationMatrix2D は画像上で反時計回りなので、レイの角度とは符号が逆
+    return wrapAngle(-rotation * M_PI / 180);
+}
+
+
+
+// ---
+
+
+
+SyntheticScene::SyntheticScene(const Params& params)
+    : params_(params)
+    , rng_(params.seed)
+    , frameCount_(0)
+{
+    // マーカは白いピースの中央に貼られている
+    const int markerSide = std::max(7, cvRound(params_.markerSize));
+    const int pieceSide  = cvRound(markerSide * 2.2);
+    for (int i = 0; i < params_.markerCount; ++i) {
+        const int id = (1 + i * 7) % 1024;
+        cv::Mat patch(pieceSide, pieceSide, CV_8UC1, cv::Scalar(objectLevel));
+        cv::Mat marker = aruco::FiducidalMarkers::createMarkerImage(id, markerSide, false);
+        marker.setTo(cv::Scalar(backgroundLevel), marker == 0);
+        marker.setTo(cv::Scalar(objectLevel),     marker > backgroundLevel);
+        const int offset = (pieceSide - markerSide) / 2;
+        marker.copyTo(patch(cv::Rect(offset, offset, markerSide, markerSide)));
+
+        markerPatches_.push_back(patch);
+        markerMasks_.push_back(cv::Mat(patch.size(), CV_8UC1, cv::Scalar(255)));
+    }
+    markerRadius_ = pieceSide / std::sqrt(2.0);
+
+    const int landoltSide = cvCeil(params_.landoltSize) + 4;
+    landoltPatch_ = cv::Mat::zeros(landoltSide, landoltSide, CV_8UC1);
+    drawLandolt(landoltPatch_, params_.landoltSize, objectLevel);
+    landoltMask_ = landoltPatch_ > 0;
+    landoltRadius_ = params_.landoltSize / 2;
+
+    // 重ならないように格子状に並べてから少しずらす
+    const int count = params_.markerCount + params_.landoltCount;
+    const int cells = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    const double cellWidth  = 1.0 * params_.size.width  / cells;
+    const double cellHeight = 1.0 * params_.size.height / cells;
+    std::vector<int> slots(cells * cells);
+    for (unsigned int i = 0; i < slots.size(); ++i) {
+        slots[i] = i;
+    }
+    for (int i = static_cast<int>(slots.size()) - 1; i > 0; --i) {
+        std::swap(slots[i], slots[rng_.uniform(0, i + 1)]);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        SceneObject object;
+        object.id = (i < params_.markerCount) ? (1 + i * 7) % 1024 : i - params_.markerCount;
+        const double jitter = 0.1;
+        object.position = cv::Point2d(
+            cellWidth  * (slots[i] % cells + 0.5 + rng_.uniform(-jitter, jitter)),
+            cellHeight * (slots[i] / cells + 0.5 + rng_.uniform(-jitter, jitter)));
+        const double direction = rng_.uniform(0.0, 2 * M_PI);
+        object.velocity = cv::Point2d(std::cos(direction), std::sin(direction)) * params_.speed;
+        object.rotation = rng_.uniform(0.0, 360.0);
+        object.angularVelocity = params_.angularSpeed * (rng_.uniform(0, 2) ? 1 : -1);
+
+        if (i < params_.markerCount) {
+            markers_.push_back(object);
+        } else {
+            landolts_.push_back(object);
+        }
+    }
+
+    // 中心からの距離の 2 乗で暗くなる
+    gain_.create(params_.size, CV_32FC1);
+    const cv::Point2d center((params_.size.width - 1) / 2.0, (params_.size.height - 1) / 2.0);
+    const double maxDistance2 = center.x * center.x + center.y * center.y;
+    for (int y = 0; y < gain_.rows; ++y) {
+        auto row = gain_.ptr<float>(y);
+        for (int x = 0; x < gain_.cols; ++x) {
+            const double dx = x - center.x;
+            const double dy = y - center.y;
+            row[x] = static_cast<float>(1.0 - params_.falloff * (dx * dx + dy * dy) / maxDistance2);
+        }
+    }
+}
+
+
+bool SyntheticScene::isValid() const
+{
+    return params_.size.area() > 0;
+}
+
+
+const SyntheticScene::Params& SyntheticScene::params() const
+{
+    return params_;
+}
+
+
+const std::vector<SceneObject>& SyntheticScene::markers() const
+{
+    return markers_;
+}
+
+
+const std::vector<SceneObject>& SyntheticScene::landolts() const
+{
+    return landolts_;
+}
+
+
+bool SyntheticScene::next(cv::Mat& frame)
+{
+    // 真値 (markers() / landolts()) は最後に返したフレームの露光中心の姿勢
+    if (frameCount_ > 0) {
+        advance(markers_, markerRadius_);
+        advance(landolts_, landoltRadius_);
+    }
+    ++frameCount_;
+
+    // 露光中の位置を少しずつずらして重ねることでモーションブラーを作る
+    const int samples = std::max(1, params_.blurSamples);
+    cv::Mat accumulation = cv::Mat::zeros(params_.size, CV_32FC1);
+    cv::Mat canvas(params_.size, CV_8UC1);
+    for (int i = 0; i < samples; ++i) {
+        const double t = (i + 0.5) / samples - 0.5;
+        render(canvas, t);
+        cv::accumulate(canvas, accumulation);
+    }
+    accumulation *= 1.0 / samples;
+
+    frame = finish(accumulation);
+
+    return true;
+}
+
+
+cv::Mat SyntheticScene::templateImage() const
+{
+    const int side = cvCeil(params_.landoltSize * 2) + 4;
+    cv::Mat gray = cv::Mat::zeros(side, side, CV_8UC1);
+    drawLandolt(gray, params_.landoltSize * 2, 255);
+
+    cv::Mat image;
+    cv::cvtColor(gray, image, cv::COLOR_GRAY2BGR);
+    return image;
+}
+
+
+cv::Mat SyntheticScene::backgroundImage() const
+{
+    cv::Mat background(params_.size, CV_32FC1, cv::Scalar(backgroundLevel));
+    background = background.mul(gain_);
+
+    cv::Mat gray, image;
+    background.convertTo(gray, CV_8U);
+    cv::cvtColor(gray, image, cv::COLOR_GRAY2BGR);
+    return image;
+}
+
+
+void SyntheticScene::advance(std::vector<SceneObject>& objects, double radius)
+{
+    // 端に来たら跳ね返る
+    const double right  = params_.size.width  - radius;
+    const double bottom = params_.size.height - radius;
+    for (auto&& object : objects) {
+        object.position += object.velocity;
+        object.rotation += object.angularVelocity;
+        if (object.position.x < radius || object.position.x > right) {
+            object.velocity.x *= -1;
+            object.position.x = std::min(std::max(object.position.x, radius), right);
+        }
+        if (object.position.y < radius || object.position.y > bottom) {
+            object.velocity.y *= -1;
+            object.position.y = std::min(std::max(object.position.y, radius), bottom);
+        }
+    }
+}
+
+
+void SyntheticScene::render(cv::Mat& canvas, double t) const
+{
+    canvas.setTo(cv::Scalar(backgroundLevel));
+
+    for (unsigned int i = 0; i < markers_.size(); ++i) {
+        const auto& marker = markers_[i];
+        draw(canvas, markerPatches_[i], markerMasks_[i],
+            marker.position + marker.velocity * t,
+            marker.rotation + marker.angularVelocity * t);
+    }
+
+    for (const auto& landolt : landolts_) {
+        draw(canvas, landoltPatch_, landoltMask_,
+            landolt.position + landolt.velocity * t,
+            landolt.rotation + landolt.angularVelocity * t);
+    }
+}
+
+
+void SyntheticScene::draw(cv::Mat& canvas, const cv::Mat& patch, const cv::Mat& mask, const cv::Point2d& position, double rotation) const
+{
+    // パッチの中心を position に合わせて回転させ、影響範囲だけ warp する
+    const cv::Point2f center((patch.cols - 1) / 2.f, (patch.rows - 1) / 2.f);
+    const double halfDiagonal = 0.5 * std::sqrt(1.0 * patch.cols * patch.cols + patch.rows * patch.rows);
+    const cv::Rect area(
+        cvFloor(position.x - halfDiagonal),
+        cvFloor(position.y - halfDiagonal),
+        cvCeil(2 * halfDiagonal) + 1,
+        cvCeil(2 * halfDiagonal) + 1);
+    const cv::Rect roi = area & cv::Rect(0, 0, canvas.cols, canvas.rows);
+    if (roi.area() == 0) return;
+
+    cv::Mat affine = cv::getRotationMatrix2D(center, rotation, 1.0);
+    affine.at<double>(0, 2) += position.x - center.x - roi.x;
+    affine.at<double>(1, 2) += position.y - center.y - roi.y;
+
+    cv::Mat warpedPatch, warpedMask;
+    cv::warpAffine(patch, warpedPatch, affine, roi.size(), cv::INTER_LINEAR);
+    cv::warpAffine(mask,  warpedMask,  affine, roi.size(), cv::INTER_NEAREST);
+
+    cv::Mat target = canvas(roi);
+    warpedPatch.copyTo(target, warpedMask);
+}
+
+
+cv::Mat SyntheticScene::finish(const cv::Mat& accumulation)
+{
+    cv::Mat image = accumulation.mul(gain_);
+
+    if (params_.noise > 0) {
+        cv::Mat noise(image.size(), CV_32FC1);
+        rng_.fill(noise, cv::RNG::NORMAL, 0, params_.noise);
+        image += noise;
+    }
+
+    cv::Mat gray, bgr;
+    image.convertTo(gray, CV_8U);
+    cv::cvtColor(gray, bgr, cv::COLOR_GRAY2BGR);
+    return bgr;
+}
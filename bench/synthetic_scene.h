@@ -0,0 +1,88 @@
+﻿#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <vector>
+#include "frame_source.h"
+
+
+namespace Littai
+{
+
+
+// 合成シーン上の物体（マーカ付きのピース or ランドルト環）の真値
+struct SceneObject
+{
+    int id;
+    cv::Point2d position;
+    cv::Point2d velocity;     // px / frame
+    double rotation;          // deg（cv::getRotationMatrix2D と同じ向き）
+    double angularVelocity;   // deg / frame
+
+    // 各トラッカーと同じ定義で求めた角度 (rad)
+    double markerAngle() const;
+    double landoltAngle() const;
+};
+
+
+// ArUco マーカとランドルト環を既知の姿勢で描画するフレーム供給元
+// 動き、モーションブラー、ノイズ、IR の周辺減光を付けられる
+class SyntheticScene : public FrameSource
+{
+public:
+    struct Params
+    {
+        cv::Size size;
+        int markerCount;
+        int landoltCount;
+        double markerSize;       // マーカ 1 辺 (px)
+        double landoltSize;      // ランドルト環の直径 (px)
+        double speed;            // 移動速度 (px / frame)
+        double angularSpeed;     // 回転速度 (deg / frame)
+        int blurSamples;         // 露光中のサブフレーム数（1 でブラーなし）
+        double noise;            // ガウスノイズの標準偏差
+        double falloff;          // 周辺減光の強さ (0 - 1)
+        unsigned int seed;
+
+        Params()
+            : size(480, 480), markerCount(4), landoltCount(4)
+            , markerSize(24.0), landoltSize(48.0)
+            , speed(0.0), angularSpeed(0.0)
+            , blurSamples(1), noise(0.0), falloff(0.0), seed(0)
+        {
+        }
+    };
+
+    explicit SyntheticScene(const Params& params);
+
+    bool isValid() const override;
+    bool next(cv::Mat& frame) override;
+
+    const Params& params() const;
+    const std::vector<SceneObject>& markers() const;
+    const std::vector<SceneObject>& landolts() const;
+
+    // ランドルト環のテンプレート（LandoltTracker の想定どおり 2 倍の大きさ）
+    cv::Mat templateImage() const;
+    // 物体のない背景（DiffImage の基準画像）
+    cv::Mat backgroundImage() const;
+
+private:
+    void advance(std::vector<SceneObject>& objects, double radius);
+    void render(cv::Mat& canvas, double t) const;
+    void draw(cv::Mat& canvas, const cv::Mat& patch, const cv::Mat& mask, const cv::Point2d& position, double rotation) const;
+    cv::Mat finish(const cv::Mat& accumulation);
+
+    Params params_;
+    cv::RNG rng_;
+    int frameCount_;
+    double markerRadius_, landoltRadius_;
+    std::vector<SceneObject> markers_, landolts_;
+    std::vector<cv::Mat> markerPatches_, markerMasks_;
+    cv::Mat landoltPatch_, landoltMask_;
+    cv::Mat gain_;
+};
+
+
+}
+
+#endif // SYNTHETIC_SCENE_H
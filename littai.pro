@@ -25,3 +25,4 @@ include(realsense/realsense.pri)
 include(kinect_v2/kinect_v2.pri)
 include(aruco/aruco.pri)
 include(osc/osc.pri)
+include(pipeline/pipeline.pri)
@@ -1,4 +1,5 @@
 ﻿#include <QApplication>
+#include <QCoreApplication>
 #include <QQmlApplicationEngine>
 #include <QtQuick>
 
@@ -7,6 +8,8 @@
 #include "homography.h"
 #include "diff_image.h"
 #include "reverse_image.h"
+#include "recorder.h"
+#include "replay.h"
 #include "landolt_tracker.h"
 #include "xtion.h"
 #include "realsense.h"
@@ -14,13 +17,51 @@
 #include "marker_tracker.h"
 #include "osc_receiver.h"
 #include "osc_sender.h"
+#include "pipeline.h"
+#include "headless_pipeline.h"
 
 using namespace Littai;
 
 
 
+namespace
+{
+    // --headless <config.json> が指定されていればそのパスを返す
+    QString headlessConfigPath(int argc, char *argv[])
+    {
+        for (int i = 1; i + 1 < argc; ++i) {
+            if (QString(argv[i]) == "--headless") {
+                return QString::fromLocal8Bit(argv[i + 1]);
+            }
+        }
+        return QString();
+    }
+
+    // QML もシーングラフも作らずにパイプラインだけを回す
+    int runHeadless(int argc, char *argv[], const QString& configPath)
+    {
+        QCoreApplication app(argc, argv);
+
+        HeadlessPipeline pipeline;
+        if (!pipeline.load(configPath)) {
+            return 1;
+        }
+        QObject::connect(&app, SIGNAL(aboutToQuit()), &pipeline, SLOT(stop()));
+        pipeline.start();
+
+        return app.exec();
+    }
+}
+
+
+
 int main(int argc, char *argv[])
 {
+    const auto configPath = headlessConfigPath(argc, argv);
+    if (!configPath.isEmpty()) {
+        return runHeadless(argc, argv, configPath);
+    }
+
     QApplication app(argc, argv);
 
     qmlRegisterType<Image>("Littai", 1, 0, "Image");
@@ -28,6 +69,8 @@ int main(int argc, char *argv[])
     qmlRegisterType<Homography>("Littai", 1, 0, "Homography");
     qmlRegisterType<DiffImage>("Littai", 1, 0, "DiffImage");
     qmlRegisterType<ReverseImage>("Littai", 1, 0, "ReverseImage");
+    qmlRegisterType<Recorder>("Littai", 1, 0, "Recorder");
+    qmlRegisterType<Replay>("Littai", 1, 0, "Replay");
     qmlRegisterType<LandoltTracker>("Littai", 1, 0, "LandoltTracker");
     qmlRegisterType<Xtion>("Littai", 1, 0, "Xtion");
     qmlRegisterType<RealSense>("Littai", 1, 0, "RealSense");
@@ -35,6 +78,7 @@ int main(int argc, char *argv[])
     qmlRegisterType<MarkerTracker>("Littai", 1, 0, "MarkerTracker");
     qmlRegisterType<OSCReceiver>("Littai", 1, 0, "OscReceiver");
     qmlRegisterType<OSCSender>("Littai", 1, 0, "OscSender");
+    qmlRegisterType<Pipeline>("Littai", 1, 0, "Pipeline");
 
     QQmlApplicationEngine engine;
     engine.load(QUrl(QStringLiteral("qrc:/qml/main.qml")));
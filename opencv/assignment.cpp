@@ -0,0 +1,80 @@
+﻿#include <limits>
+#include <algorithm>
+#include "assignment.h"
+
+using namespace Littai;
+
+
+
+std::vector<int> Littai::solveAssignment(const std::vector<double>& cost, int rows, int cols, double maxCost)
+{
+    std::vector<int> assignment(rows, -1);
+    if (rows == 0 || cols == 0) return assignment;
+
+    // 行と列それぞれにダミーを足した正方行列にして、ダミーとの組を「割り当てなし」とする
+    // a[i][j] (1 始まり) : 実際の組 / 行とダミー列 / ダミー行と列 / ダミー同士
+    const int n = rows + cols;
+    const double forbidden = 1e12;
+    auto a = [&](int i, int j) -> double {
+        const bool isRow = i <= rows;
+        const bool isCol = j <= cols;
+        if (isRow && isCol) {
+            const auto c = cost[(i - 1) * cols + (j - 1)];
+            return (c < maxCost) ? c : forbidden;
+        }
+        if (isRow || isCol) return maxCost;
+        return 0;
+    };
+
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> u(n + 1, 0), v(n + 1, 0), minv(n + 1);
+    std::vector<int> p(n + 1, 0), way(n + 1, 0);
+    std::vector<bool> used(n + 1);
+
+    for (int i = 1; i <= n; ++i) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), inf);
+        std::fill(used.begin(), used.end(), false);
+        do {
+            used[j0] = true;
+            const int i0 = p[j0];
+            double delta = inf;
+            int j1 = 0;
+            for (int j = 1; j <= n; ++j) {
+                if (used[j]) continue;
+                const auto current = a(i0, j) - u[i0] - v[j];
+                if (current < minv[j]) {
+                    minv[j] = current;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n; ++j) {
+                if (used[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            const int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (int j = 1; j <= cols; ++j) {
+        const int i = p[j];
+        if (i >= 1 && i <= rows && cost[(i - 1) * cols + (j - 1)] < maxCost) {
+            assignment[i - 1] = j - 1;
+        }
+    }
+    return assignment;
+}
@@ -0,0 +1,20 @@
+﻿#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <vector>
+
+
+namespace Littai
+{
+
+
+// 最小コストの割り当て（ハンガリアン法、Qt に依存しない）
+// cost は rows x cols の行優先で、maxCost 以上の組は割り当てない
+// 割り当てないことのコストを maxCost として全体の和が最小になるように選ぶ
+// 戻り値は行ごとの割り当て先の列（無ければ -1）
+std::vector<int> solveAssignment(const std::vector<double>& cost, int rows, int cols, double maxCost);
+
+
+}
+
+#endif // ASSIGNMENT_H
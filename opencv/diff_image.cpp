@@ -10,52 +10,106 @@ DiffImage::DiffImage(QQuickItem *parent)
     , sharpness_(1.f)
     , intensityCorrectionMin_(50.0)
     , intensityCorrectionMax_(250.0)
+    , isAdaptiveBackground_(false)
+    , backgroundRate_(0.01)
+    , foregroundSigma_(3.0)
+    , foregroundMinDiff_(10.0)
 {
+    // ワーカスレッドから呼ばれる（QML 側へはキューで届く）
+    engine_.setBaseImageCallback([this](const cv::Mat& image) {
+        emit baseImageCaptured(QVariant::fromValue(image));
+        emit baseImageChanged();
+        emit intensityCorrectionImageChanged();
+    });
 }
 
 
-void DiffImage::unsharpMask(cv::Mat &image, float k)
+DiffImage::~DiffImage()
 {
-    float kernelData[] = {
-        -k/9.0f, -k/9.0f,           -k/9.0f,
-        -k/9.0f, 1 + (8 * k)/9.0f,  -k/9.0f,
-        -k/9.0f, -k/9.0f,           -k/9.0f,
-    };
-    cv::Mat filter(cv::Size(3, 3), CV_32F, kernelData);
-    cv::filter2D(image, image, image.depth(), filter);
+    // 集計中のキャプチャが壊れかけのオブジェクトにシグナルを送らないよう、ここで待つ
+    engine_.setBaseImageCallback(nullptr);
+    detachFromPipeline();
+    engine_.cancelCapture();
 }
 
 
-void DiffImage::setBaseImage(const QVariant &image)
+Stage& DiffImage::stage()
 {
-    auto baseImage = image.value<cv::Mat>();
-    if (baseImage.empty()) return;
+    return engine_;
+}
 
-    unsharpMask(baseImage, sharpness_);
 
-    cv::Mat gray;
-    cv::cvtColor(baseImage, gray, cv::COLOR_BGR2GRAY);
+void DiffImage::updateParams()
+{
+    DiffImageEngine::Params params;
+    params.gamma                  = gamma_;
+    params.sharpness              = sharpness_;
+    params.intensityCorrectionMin = intensityCorrectionMin_;
+    params.intensityCorrectionMax = intensityCorrectionMax_;
+    params.isAdaptiveBackground   = isAdaptiveBackground_;
+    params.backgroundRate         = backgroundRate_;
+    params.foregroundSigma        = foregroundSigma_;
+    params.foregroundMinDiff      = foregroundMinDiff_;
+    engine_.setParams(params);
+}
 
-    baseImage_ = gray;
 
-    emit baseImageChanged();
+void DiffImage::setBaseImage(const QVariant &image)
+{
+    const auto baseImage = image.value<cv::Mat>();
+    if (baseImage.empty()) return;
 
-    createIntensityCorrectionImage();
+    updateParams();
+    engine_.setBaseImage(baseImage);
+
+    emit baseImageChanged();
+    emit intensityCorrectionImageChanged();
 }
 
 
 QVariant DiffImage::baseImage() const
 {
+    const auto gray = engine_.baseImage();
+    if (gray.empty()) return QVariant::fromValue(gray);
+
     cv::Mat color;
-    cv::cvtColor(baseImage_, color, cv::COLOR_GRAY2BGR);
+    cv::cvtColor(gray, color, cv::COLOR_GRAY2BGR);
     return QVariant::fromValue(color);
 }
 
 
+void DiffImage::captureBaseImage(int frames, bool isMedian)
+{
+    updateParams();
+    engine_.captureBaseImage(frames, isMedian);
+}
+
+
+void DiffImage::setFlatFieldImage(const QVariant &image)
+{
+    flatFieldImage_ = image.value<cv::Mat>().clone();
+
+    updateParams();
+    engine_.setFlatFieldImage(flatFieldImage_);
+
+    emit flatFieldImageChanged();
+    emit intensityCorrectionImageChanged();
+}
+
+
+QVariant DiffImage::flatFieldImage() const
+{
+    return QVariant::fromValue(flatFieldImage_);
+}
+
+
 QVariant DiffImage::intensityCorrectionImage() const
 {
+    const auto gray = engine_.intensityCorrectionImage();
+    if (gray.empty()) return QVariant::fromValue(gray);
+
     cv::Mat color;
-    cv::cvtColor(intensityCorrectionImage_, color, cv::COLOR_GRAY2BGR);
+    cv::cvtColor(gray, color, cv::COLOR_GRAY2BGR);
     return QVariant::fromValue(color);
 }
 
@@ -65,20 +119,12 @@ void DiffImage::setInputImage(const QVariant &image)
     image.value<cv::Mat>().copyTo(inputImage_);
     emit inputImageChanged();
 
-    if (baseImage_.empty()) {
-        setImage(inputImage_);
-    } else {
-        cv::Mat gray;
-        cv::cvtColor(inputImage_, gray, cv::COLOR_BGR2GRAY);
-        unsharpMask(gray, sharpness_);
-        cv::subtract(gray, baseImage_, gray);
-        applyIntensityCorrection(gray);
+    updateParams();
 
-        cv::Mat outputImage;
-        cv::cvtColor(gray, outputImage, cv::COLOR_GRAY2BGR);
+    cv::Mat outputImage;
+    engine_.process(inputImage_, outputImage);
 
-        setImage(outputImage);
-    }
+    setImage(outputImage);
 }
 
 
@@ -88,46 +134,8 @@ QVariant DiffImage::inputImage() const
 }
 
 
-void DiffImage::createIntensityCorrectionImage()
-{
-    // 100 を基準にどれだけ得られた画像の強度を変化させるか（200 なら 2 倍）
-    cv::Mat image(baseImage_.size(), baseImage_.type());
-    for (int x = 0; x < image.cols; ++x) {
-        for (int y = 0; y < image.rows; ++y) {
-            for (int c = 0; c < image.channels(); ++c) {
-                const int index = y * image.step + x * image.elemSize() + c;
-                image.data[index] = intensityCorrectionMin_ + (intensityCorrectionMax_ - intensityCorrectionMin_) * (1.0 - 1.0 * y / image.rows);
-            }
-        }
-    }
-    intensityCorrectionImage_ = image.clone();
-    /*
-    auto image = baseImage_.clone();
-    const int cols = image.cols;
-    const int rows = image.rows;
-    const int blur = 31;
-    const int margin = 30;
-    cv::medianBlur(image, image, blur);
-    image = image(cv::Rect(cv::Point(margin, margin), cv::Point(rows - margin, cols - margin))).clone();
-    cv::resize(image, intensityCorrectionImage_, cv::Size(rows, cols));
-    */
-    emit intensityCorrectionImageChanged();
-}
-
-
-void DiffImage::applyIntensityCorrection(cv::Mat &image)
+void DiffImage::setOutput(const cv::Mat& output)
 {
-    if (image.total() != intensityCorrectionImage_.total()) return;
-
-    #pragma omp parallel for private(x, y, c)
-    for (int x = 0; x < image.cols; ++x) {
-        for (int y = 0; y < image.rows; ++y) {
-            for (int c = 0; c < image.channels(); ++c) {
-                const int index = y * image.step + x * image.elemSize() + c;
-                auto val = image.data[index] * (1.0 * intensityCorrectionImage_.data[index] / 100);
-                if (val > 255) val = 255;
-                image.data[index] = static_cast<int>(pow(val / 255.0, gamma_) * 255);
-            }
-        }
-    }
+    setImage(output, false);
+    QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
 }
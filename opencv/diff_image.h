@@ -2,50 +2,72 @@
 #define DIFF_IMAGE_H
 
 #include "image.h"
+#include "diff_image_engine.h"
+#include "pipeline_stage.h"
 
 
 namespace Littai
 {
 
 
-class DiffImage : public Image
+class DiffImage : public Image, public PipelineStage
 {
     Q_OBJECT
     Q_PROPERTY(QVariant baseImage WRITE setBaseImage READ baseImage NOTIFY baseImageChanged)
     Q_PROPERTY(QVariant inputImage WRITE setInputImage READ inputImage NOTIFY inputImageChanged)
+    Q_PROPERTY(QVariant flatFieldImage WRITE setFlatFieldImage READ flatFieldImage NOTIFY flatFieldImageChanged)
     Q_PROPERTY(QVariant intensityCorrectionImage READ intensityCorrectionImage NOTIFY intensityCorrectionImageChanged)
     Q_PROPERTY(double gamma MEMBER gamma_ NOTIFY gammaChanged)
     Q_PROPERTY(float sharpness MEMBER sharpness_ NOTIFY sharpnessChanged)
     Q_PROPERTY(double intensityCorrectionMin MEMBER intensityCorrectionMin_ NOTIFY intensityCorrectionMinChanged)
     Q_PROPERTY(double intensityCorrectionMax MEMBER intensityCorrectionMax_ NOTIFY intensityCorrectionMaxChanged)
+    Q_PROPERTY(bool isAdaptiveBackground MEMBER isAdaptiveBackground_ NOTIFY isAdaptiveBackgroundChanged)
+    Q_PROPERTY(double backgroundRate MEMBER backgroundRate_ NOTIFY backgroundRateChanged)
+    Q_PROPERTY(double foregroundSigma MEMBER foregroundSigma_ NOTIFY foregroundSigmaChanged)
+    Q_PROPERTY(double foregroundMinDiff MEMBER foregroundMinDiff_ NOTIFY foregroundMinDiffChanged)
 
 public:
     explicit DiffImage(QQuickItem *parent = 0);
+    ~DiffImage();
 
     void setBaseImage(const QVariant& image);
     QVariant baseImage() const;
+    void setFlatFieldImage(const QVariant& image);
+    QVariant flatFieldImage() const;
     QVariant intensityCorrectionImage() const;
+    Q_INVOKABLE void captureBaseImage(int frames, bool isMedian = false);
     void setInputImage(const QVariant& image);
     QVariant inputImage() const;
 
-private:
-    void unsharpMask(cv::Mat& image, float k);
-    void createIntensityCorrectionImage();
-    void applyIntensityCorrection(cv::Mat& image);
+    Stage& stage() override;
+    void updateParams() override;
+    void setOutput(const cv::Mat& output) override;
 
-    cv::Mat baseImage_, inputImage_, intensityCorrectionImage_;
+private:
+    DiffImageEngine engine_;
+    cv::Mat inputImage_;
+    cv::Mat flatFieldImage_;
     double gamma_;
     float sharpness_;
     double intensityCorrectionMax_, intensityCorrectionMin_;
+    bool isAdaptiveBackground_;
+    double backgroundRate_;
+    double foregroundSigma_, foregroundMinDiff_;
 
 signals:
     void baseImageChanged() const;
+    void baseImageCaptured(const QVariant& capturedImage) const;
     void inputImageChanged() const;
     void gammaChanged() const;
     void sharpnessChanged() const;
+    void flatFieldImageChanged() const;
     void intensityCorrectionImageChanged() const;
     void intensityCorrectionMinChanged() const;
     void intensityCorrectionMaxChanged() const;
+    void isAdaptiveBackgroundChanged() const;
+    void backgroundRateChanged() const;
+    void foregroundSigmaChanged() const;
+    void foregroundMinDiffChanged() const;
 };
 
 
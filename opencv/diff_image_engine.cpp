@@ -0,0 +1,457 @@
+﻿#include <algorithm>
+#include <cmath>
+#include "diff_image_engine.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // 画素ごとの中央値（一瞬横切った手や点滅するノイズが残らない）
+    cv::Mat medianImage(const std::vector<cv::Mat>& frames)
+    {
+        const auto& first = frames.front();
+        const int n = static_cast<int>(frames.size());
+        const int width = first.cols * first.channels();
+        cv::Mat median(first.size(), first.type());
+
+        #pragma omp parallel for
+        for (int y = 0; y < first.rows; ++y) {
+            std::vector<const uchar*> rows(n);
+            for (int i = 0; i < n; ++i) {
+                rows[i] = frames[i].ptr<uchar>(y);
+            }
+            std::vector<uchar> values(n);
+            auto dst = median.ptr<uchar>(y);
+            for (int x = 0; x < width; ++x) {
+                for (int i = 0; i < n; ++i) {
+                    values[i] = rows[i][x];
+                }
+                std::nth_element(values.begin(), values.begin() + n / 2, values.end());
+                dst[x] = values[n / 2];
+            }
+        }
+
+        return median;
+    }
+}
+
+
+
+DiffImageEngine::DiffImageEngine()
+    : baseSharpness_(0.f)
+    , lutGamma_(1.0)
+    , captureFrames_(0)
+    , isCaptureMedian_(false)
+    , isCapturing_(false)
+    , capturedCount_(0)
+    , captureType_(0)
+{
+}
+
+
+DiffImageEngine::~DiffImageEngine()
+{
+    cancelCapture();
+}
+
+
+std::string DiffImageEngine::name() const
+{
+    return "diff";
+}
+
+
+void DiffImageEngine::setParams(const Params& params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    params_ = params;
+}
+
+
+DiffImageEngine::Params DiffImageEngine::params() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return params_;
+}
+
+
+void DiffImageEngine::unsharpMask(cv::Mat &image, float k)
+{
+    // 3x3 の平均との差を k 倍して足す（x + k (9x - S) / 9、S は 3x3 の和）
+    // 横 3 画素の和を行ごとに求めて 3 行分だけ持ち、縦に足して S にする
+    // 係数は 8bit の固定小数点、端は filter2D と同じ BORDER_REFLECT_101
+    CV_Assert(image.depth() == CV_8U);
+    if (k == 0.f || image.rows < 2 || image.cols < 2) return;
+
+    const int rows  = image.rows;
+    const int cn    = image.channels();
+    const int width = image.cols * cn;
+    const int gain  = cvRound(k * 256 / 9.0);
+
+    // 行 y の横の和は unsharpRows_ の (y % 3) 行目に入れる
+    unsharpRows_.resize(width * 3);
+    int* const slots[3] = { &unsharpRows_[0], &unsharpRows_[width], &unsharpRows_[width * 2] };
+    const auto sumRow = [&](int y) {
+        const uchar* src = image.ptr<uchar>(y);
+        int* dst = slots[y % 3];
+        for (int x = 0; x < cn; ++x) {
+            dst[x] = src[x] + 2 * src[x + cn];
+        }
+        for (int x = cn; x < width - cn; ++x) {
+            dst[x] = src[x - cn] + src[x] + src[x + cn];
+        }
+        for (int x = width - cn; x < width; ++x) {
+            dst[x] = src[x] + 2 * src[x - cn];
+        }
+    };
+
+    // 行 y を書き換える前に行 y + 1 の和を取っておけば、その場で上書きできる
+    sumRow(0);
+    for (int y = 0; y < rows; ++y) {
+        if (y + 1 < rows) sumRow(y + 1);
+        const int* above = slots[(y > 0 ? y - 1 : 1) % 3];
+        const int* row   = slots[y % 3];
+        const int* below = slots[(y + 1 < rows ? y + 1 : rows - 2) % 3];
+        uchar* dst = image.ptr<uchar>(y);
+        for (int x = 0; x < width; ++x) {
+            const int sum = above[x] + row[x] + below[x];
+            const int v = dst[x];
+            dst[x] = cv::saturate_cast<uchar>(v + (((9 * v - sum) * gain + 128) >> 8));
+        }
+    }
+}
+
+
+void DiffImageEngine::setBaseImage(const cv::Mat &image)
+{
+    if (image.empty()) return;
+
+    // グレースケール化はロックの外で。鮮鋭化したものは sharpness が変わるまで使い回す
+    cv::Mat gray;
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    rawBaseImage_ = gray;
+    updateSharpenedBase();
+
+    updateIntensityCorrection(baseImage_.size());
+}
+
+
+void DiffImageEngine::setFlatFieldImage(const cv::Mat &image)
+{
+    // 一様な明るさの面を撮った画像から、平均の明るさに揃えるゲインの格子を求める
+    // （格子点の周りをぼかした値を使う。空の画像なら縦の傾斜に戻す）
+    cv::Mat grid;
+    if (!image.empty()) {
+        cv::Mat gray;
+        if (image.channels() == 3) {
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        } else {
+            gray = image;
+        }
+        cv::Mat blurred;
+        cv::blur(gray, blurred, cv::Size(gray.cols / 8 | 1, gray.rows / 8 | 1));
+
+        const int n = 9;
+        grid.create(n, n, CV_32FC1);
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < n; ++i) {
+                const int x = i * (gray.cols - 1) / (n - 1);
+                const int y = j * (gray.rows - 1) / (n - 1);
+                grid.at<float>(j, i) = std::max(1.f, static_cast<float>(blurred.at<uchar>(y, x)));
+            }
+        }
+        cv::divide(cv::mean(grid)[0], grid, grid);
+        cv::min(grid, 4.0, grid);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    flatFieldGrid_ = grid;
+    if (!baseImage_.empty()) {
+        updateIntensityCorrection(baseImage_.size());
+    }
+}
+
+
+void DiffImageEngine::updateSharpenedBase()
+{
+    rawBaseImage_.copyTo(baseImage_);
+    unsharpMask(baseImage_, params_.sharpness);
+    baseSharpness_ = params_.sharpness;
+
+    // 適応背景も鮮鋭化した基準画像から始め直す
+    backgroundMean_.release();
+}
+
+
+cv::Mat DiffImageEngine::baseImage() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return baseImage_.clone();
+}
+
+
+cv::Mat DiffImageEngine::intensityCorrectionImage() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return intensityCorrectionImage_.clone();
+}
+
+
+void DiffImageEngine::captureBaseImage(int frames, bool isMedian)
+{
+    // 前回の集計が終わるのを待つ（差し替えで mutex_ を取るので、ここでは持たない）
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(captureMutex_);
+        thread.swap(captureThread_);
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    captureFrames_ = std::max(1, std::min(255, frames));
+    isCaptureMedian_ = isMedian;
+    isCapturing_ = true;
+    capturedCount_ = 0;
+    capturedFrames_.clear();
+    captureSum_.release();
+}
+
+
+void DiffImageEngine::cancelCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        captureFrames_ = 0;
+        capturedCount_ = 0;
+        capturedFrames_.clear();
+        captureSum_.release();
+    }
+
+    // 差し替えで mutex_ を取るので、ロックを持たずに join する
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(captureMutex_);
+        thread.swap(captureThread_);
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    isCapturing_ = false;
+}
+
+
+bool DiffImageEngine::isCapturingBaseImage() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isCapturing_;
+}
+
+
+void DiffImageEngine::setBaseImageCallback(const std::function<void(const cv::Mat&)>& callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    baseImageCallback_ = callback;
+}
+
+
+void DiffImageEngine::finishCapture(const std::vector<cv::Mat>& frames, const cv::Mat& sum, int count)
+{
+    // 中央値ならフレームから求め、平均なら 16bit の和を枚数で割る
+    cv::Mat image;
+    if (!frames.empty()) {
+        image = medianImage(frames);
+    } else {
+        sum.convertTo(image, CV_8U, 1.0 / count);
+    }
+    setBaseImage(image);
+
+    std::function<void(const cv::Mat&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isCapturing_ = false;
+        callback = baseImageCallback_;
+    }
+    if (callback) {
+        callback(image);
+    }
+}
+
+
+void DiffImageEngine::process(const cv::Mat& input, cv::Mat& output)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 基準画像のキャプチャ中は入力を溜め、揃ったらワーカスレッドで仕上げる
+    // 平均は 16bit の和に足し込むだけにし、フレームを残すのは中央値のときだけ
+    if (captureFrames_ > 0 && !input.empty()) {
+        // 途中でサイズが変わったら溜め直す
+        if (capturedCount_ > 0 && (captureSize_ != input.size() || captureType_ != input.type())) {
+            capturedCount_ = 0;
+            capturedFrames_.clear();
+        }
+        if (capturedCount_ == 0) {
+            captureSize_ = input.size();
+            captureType_ = input.type();
+            if (!isCaptureMedian_) {
+                captureSum_.create(input.size(), CV_MAKETYPE(CV_16U, input.channels()));
+                captureSum_.setTo(cv::Scalar::all(0));
+            }
+        }
+
+        if (isCaptureMedian_) {
+            capturedFrames_.push_back(input.clone());
+        } else {
+            cv::add(captureSum_, input, captureSum_, cv::noArray(), captureSum_.type());
+        }
+        ++capturedCount_;
+
+        if (capturedCount_ >= captureFrames_) {
+            std::vector<cv::Mat> frames;
+            frames.swap(capturedFrames_);
+            const cv::Mat sum = captureSum_;
+            captureSum_ = cv::Mat();    // 和のバッファはワーカに渡す
+            const int count = capturedCount_;
+            captureFrames_ = 0;
+            capturedCount_ = 0;
+            // captureBaseImage で前のスレッドは join 済み
+            std::lock_guard<std::mutex> threadLock(captureMutex_);
+            captureThread_ = std::thread(&DiffImageEngine::finishCapture, this, std::move(frames), sum, count);
+        }
+    }
+
+    if (baseImage_.empty()) {
+        input.copyTo(output);
+        return;
+    }
+
+    if (params_.sharpness != baseSharpness_) {
+        updateSharpenedBase();
+    }
+
+    cv::Mat gray;
+    cv::cvtColor(input, gray, cv::COLOR_BGR2GRAY);
+    unsharpMask(gray, params_.sharpness);
+    if (params_.isAdaptiveBackground) {
+        updateBackground(gray);
+    }
+    cv::subtract(gray, baseImage_, gray);
+    applyIntensityCorrection(gray, params_.gamma);
+
+    cv::cvtColor(gray, output, cv::COLOR_GRAY2BGR);
+}
+
+
+void DiffImageEngine::updateBackground(const cv::Mat& gray)
+{
+    if (gray.size() != baseImage_.size()) return;
+
+    // 登録された基準画像から始める（分散は小さめの値から）
+    if (backgroundMean_.size() != gray.size()) {
+        baseImage_.convertTo(backgroundMean_, CV_32F);
+        backgroundVar_.create(gray.size(), CV_32F);
+        backgroundVar_.setTo(cv::Scalar(4.0));
+    }
+
+    // 平均からの二乗誤差が閾値以下の画素を背景とする
+    gray.convertTo(grayFloat_, CV_32F);
+    cv::subtract(grayFloat_, backgroundMean_, squaredDiff_);
+    cv::multiply(squaredDiff_, squaredDiff_, squaredDiff_);
+    const auto sigma = params_.foregroundSigma;
+    const auto minDiff = params_.foregroundMinDiff;
+    backgroundVar_.convertTo(foregroundThreshold_, CV_32F, sigma * sigma);
+    cv::max(foregroundThreshold_, minDiff * minDiff, foregroundThreshold_);
+    cv::compare(squaredDiff_, foregroundThreshold_, backgroundMask_, cv::CMP_LE);
+
+    // 背景の画素だけ平均と分散を更新（駒が置きっぱなしでも背景に溶け込まない）
+    const auto rate = params_.backgroundRate;
+    cv::accumulateWeighted(grayFloat_, backgroundMean_, rate, backgroundMask_);
+    cv::accumulateWeighted(squaredDiff_, backgroundVar_, rate, backgroundMask_);
+
+    backgroundMean_.convertTo(baseImage_, CV_8U);
+}
+
+
+void DiffImageEngine::updateIntensityCorrection(const cv::Size& size)
+{
+    // 補正のモデル（粗いゲインの格子、1.0 で等倍）
+    // フラットフィールドが無ければ上端 intensityCorrectionMax、下端 intensityCorrectionMin の縦の傾斜（100 で等倍）
+    cv::Mat grid = flatFieldGrid_;
+    if (grid.empty()) {
+        grid = (cv::Mat_<float>(2, 1) <<
+            params_.intensityCorrectionMax / 100.0,
+            params_.intensityCorrectionMin / 100.0);
+    }
+
+    // モデルも解像度も変わっていなければ作り直さない
+    const bool isSameGrid =
+        correctionGrid_.size() == grid.size() &&
+        cv::norm(correctionGrid_, grid, cv::NORM_INF) == 0.0;
+    if (isSameGrid && gainMap_.size() == size) return;
+
+    // 格子の両端を画像の両端に合わせて双線形に広げ、256 を等倍とする固定小数点にする
+    const int gw = grid.cols;
+    const int gh = grid.rows;
+    gainMap_.create(size, CV_16UC1);
+    std::vector<float> rowGains(gw);
+    for (int y = 0; y < size.height; ++y) {
+        const float gy = (size.height > 1) ? static_cast<float>(y) * (gh - 1) / (size.height - 1) : 0.f;
+        const int y0 = std::min(static_cast<int>(gy), gh - 1);
+        const int y1 = std::min(y0 + 1, gh - 1);
+        const float fy = gy - y0;
+        for (int i = 0; i < gw; ++i) {
+            rowGains[i] = grid.at<float>(y0, i) * (1.f - fy) + grid.at<float>(y1, i) * fy;
+        }
+
+        auto dst = gainMap_.ptr<ushort>(y);
+        for (int x = 0; x < size.width; ++x) {
+            const float gx = (size.width > 1) ? static_cast<float>(x) * (gw - 1) / (size.width - 1) : 0.f;
+            const int x0 = std::min(static_cast<int>(gx), gw - 1);
+            const int x1 = std::min(x0 + 1, gw - 1);
+            const float fx = gx - x0;
+            const float gain = rowGains[x0] * (1.f - fx) + rowGains[x1] * fx;
+            dst[x] = cv::saturate_cast<ushort>(gain * 256.f);
+        }
+    }
+    correctionGrid_ = grid.clone();
+
+    // 表示・保存用（100 を等倍とした 8bit）
+    gainMap_.convertTo(intensityCorrectionImage_, CV_8U, 100.0 / 256.0);
+}
+
+
+void DiffImageEngine::applyIntensityCorrection(cv::Mat &image, double gamma)
+{
+    CV_Assert(image.type() == CV_8UC1);
+
+    updateIntensityCorrection(image.size());
+
+    // ガンマ補正は表引きにする
+    if (gammaLut_.empty() || lutGamma_ != gamma) {
+        gammaLut_.create(1, 256, CV_8UC1);
+        auto lut = gammaLut_.ptr<uchar>();
+        for (int i = 0; i < 256; ++i) {
+            lut[i] = static_cast<uchar>(std::pow(i / 255.0, gamma) * 255);
+        }
+        lutGamma_ = gamma;
+    }
+
+    // 画素ごとにゲインを掛けてシフトし、表を引くだけ
+    const auto lut = gammaLut_.ptr<uchar>();
+    #pragma omp parallel for
+    for (int y = 0; y < image.rows; ++y) {
+        auto pixels = image.ptr<uchar>(y);
+        const auto gains = gainMap_.ptr<ushort>(y);
+        for (int x = 0; x < image.cols; ++x) {
+            const int val = (pixels[x] * gains[x] + 128) >> 8;
+            pixels[x] = lut[val < 255 ? val : 255];
+        }
+    }
+}
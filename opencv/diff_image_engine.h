@@ -0,0 +1,109 @@
+﻿#ifndef DIFF_IMAGE_ENGINE_H
+#define DIFF_IMAGE_ENGINE_H
+
+#include "stage.h"
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Littai
+{
+
+
+class DiffImageEngine : public Stage
+{
+public:
+    struct Params
+    {
+        double gamma;
+        float sharpness;
+        double intensityCorrectionMin, intensityCorrectionMax;
+
+        // 基準画像を前景の無い画素だけ少しずつ更新し、環境光の変化に追従する
+        bool isAdaptiveBackground;
+        double backgroundRate;       // 1 フレームあたりの更新率
+        double foregroundSigma;      // 背景の標準偏差の何倍離れたら前景とみなすか
+        double foregroundMinDiff;    // 前景とみなす差の下限（ばらつきの小さい画素で過敏にならないように）
+
+        Params()
+            : gamma(1.0), sharpness(1.f)
+            , intensityCorrectionMin(50.0), intensityCorrectionMax(250.0)
+            , isAdaptiveBackground(false), backgroundRate(0.01)
+            , foregroundSigma(3.0), foregroundMinDiff(10.0)
+        {
+        }
+    };
+
+    DiffImageEngine();
+    ~DiffImageEngine();
+
+    void setParams(const Params& params);
+    Params params() const;
+
+    // BGR の基準画像を登録する（グレースケール化して保持、適応背景もここから始め直す）
+    void setBaseImage(const cv::Mat& image);
+    cv::Mat baseImage() const;
+    cv::Mat intensityCorrectionImage() const;
+
+    // 明るさが一様な面を撮った BGR 画像から明るさの補正を求める（空なら intensityCorrectionMin / Max の縦の傾斜）
+    void setFlatFieldImage(const cv::Mat& image);
+
+    // 次に届く frames 枚（255 枚まで）の入力の平均か画素ごとの中央値を基準画像にする
+    // 集計はワーカスレッドで行い、できあがったら一度に差し替える
+    void captureBaseImage(int frames, bool isMedian = false);
+    bool isCapturingBaseImage() const;
+    // キャプチャをやめ、集計中のワーカスレッドが終わるまで待つ（コールバックもこの中で終わる）
+    void cancelCapture();
+    // 差し替えたあとにワーカスレッドから集計した BGR 画像を渡して呼ばれる
+    void setBaseImageCallback(const std::function<void(const cv::Mat&)>& callback);
+
+    std::string name() const override;
+    void process(const cv::Mat& input, cv::Mat& output) override;
+
+private:
+    void unsharpMask(cv::Mat& image, float k);
+    void updateSharpenedBase();
+    void updateIntensityCorrection(const cv::Size& size);
+    void applyIntensityCorrection(cv::Mat& image, double gamma);
+    void updateBackground(const cv::Mat& gray);
+    void finishCapture(const std::vector<cv::Mat>& frames, const cv::Mat& sum, int count);
+
+    mutable std::mutex mutex_;
+    Params params_;
+    cv::Mat baseImage_, intensityCorrectionImage_;
+    cv::Mat rawBaseImage_;          // 鮮鋭化する前の基準画像
+    float baseSharpness_;           // baseImage_ を作ったときの sharpness
+    std::vector<int> unsharpRows_;  // unsharpMask の作業用（横の和 3 行分）
+
+    // 明るさの補正：粗いゲインの格子を入力の解像度に広げた固定小数点のマップ（CV_16U、256 で等倍）
+    cv::Mat flatFieldGrid_;     // フラットフィールドから求めた格子（CV_32F、1.0 で等倍）
+    cv::Mat correctionGrid_;    // gainMap_ の元にした格子
+    cv::Mat gainMap_;
+    cv::Mat gammaLut_;
+    double lutGamma_;
+
+    // 適応背景（画素ごとの指数移動平均と分散、CV_32F）
+    cv::Mat backgroundMean_, backgroundVar_;
+    cv::Mat grayFloat_, squaredDiff_, foregroundThreshold_, backgroundMask_;
+
+    // 基準画像のキャプチャ
+    int captureFrames_;     // 0 なら溜めていない
+    bool isCaptureMedian_;
+    bool isCapturing_;      // 集計が終わるまで true
+    int capturedCount_;
+    cv::Size captureSize_;
+    int captureType_;
+    cv::Mat captureSum_;                    // 平均のときの 16bit の和
+    std::vector<cv::Mat> capturedFrames_;   // 中央値のときだけ溜める
+    std::function<void(const cv::Mat&)> baseImageCallback_;
+
+    std::mutex captureMutex_;   // captureThread_ だけを守る（mutex_ を持ったまま join しないように分ける）
+    std::thread captureThread_;
+};
+
+
+}
+
+#endif // DIFF_IMAGE_ENGINE_H
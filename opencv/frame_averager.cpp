@@ -0,0 +1,65 @@
+﻿#include <algorithm>
+#include "frame_averager.h"
+
+using namespace Littai;
+
+
+
+FrameAverager::FrameAverager()
+    : frames_(1)
+    , count_(0)
+    , index_(0)
+{
+}
+
+
+void FrameAverager::setFrames(int frames)
+{
+    frames = std::max(1, std::min(255, frames));
+    if (frames == frames_) return;
+    frames_ = frames;
+    reset();
+}
+
+
+int FrameAverager::frames() const
+{
+    return frames_;
+}
+
+
+void FrameAverager::reset()
+{
+    count_ = 0;
+    index_ = 0;
+    ring_.clear();
+    sum_.release();
+}
+
+
+void FrameAverager::apply(cv::Mat& image)
+{
+    if (frames_ <= 1 || image.empty()) return;
+    CV_Assert(image.depth() == CV_8U);
+
+    // サイズや形式が変わったら溜め直す
+    if (sum_.size() != image.size() || sum_.channels() != image.channels()) {
+        reset();
+        ring_.resize(frames_);
+        sum_.create(image.size(), CV_MAKETYPE(CV_16U, image.channels()));
+        sum_.setTo(cv::Scalar::all(0));
+    }
+
+    // 一番古いフレームを引いてから、同じスロットに新しいフレームを入れる
+    auto& slot = ring_[index_];
+    if (count_ == frames_) {
+        cv::subtract(sum_, slot, sum_, cv::noArray(), sum_.type());
+    } else {
+        ++count_;
+    }
+    image.copyTo(slot);
+    cv::add(sum_, slot, sum_, cv::noArray(), sum_.type());
+    index_ = (index_ + 1) % frames_;
+
+    sum_.convertTo(image, CV_8U, 1.0 / count_);
+}
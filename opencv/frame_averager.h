@@ -0,0 +1,39 @@
+﻿#ifndef FRAME_AVERAGER_H
+#define FRAME_AVERAGER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+
+namespace Littai
+{
+
+
+// 直近 N フレームの移動平均（Qt に依存しない）
+// 固定長のリングバッファと 16bit の和を持ち、毎フレーム新しい 1 枚を足して一番古い 1 枚を引く
+// 溜まるまでは溜まった枚数で割るので、遅れは窓の長さを超えない
+class FrameAverager
+{
+public:
+    FrameAverager();
+
+    // 1 で素通し。8bit の和が 16bit に収まるよう 255 枚まで
+    void setFrames(int frames);
+    int frames() const;
+    void reset();
+
+    // 8bit の画像（チャンネル数は問わない）をその場で平均に置き換える
+    void apply(cv::Mat& image);
+
+private:
+    int frames_;
+    int count_;
+    int index_;
+    std::vector<cv::Mat> ring_;
+    cv::Mat sum_;
+};
+
+
+}
+
+#endif // FRAME_AVERAGER_H
@@ -0,0 +1,295 @@
+﻿#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "frame_file.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    const char magic[4] = { 'L', 'T', 'F', 'R' };
+
+    // 壊れたヘッダでサイズの計算があふれないよう、縦横の上限を決めておく
+    const std::int32_t MaxSide = 1 << 16;
+
+    std::uint64_t align(std::uint64_t size)
+    {
+        const auto a = FrameFileHeader::Alignment;
+        return (size + a - 1) / a * a;
+    }
+
+    std::uint64_t frameBytes(const FrameFileHeader& header)
+    {
+        return static_cast<std::uint64_t>(header.rows) * header.cols * CV_ELEM_SIZE(header.type);
+    }
+}
+
+
+
+// ---
+
+
+
+FrameWriter::FrameWriter()
+    : isHeaderWritten_(false)
+{
+}
+
+
+FrameWriter::~FrameWriter()
+{
+    close();
+}
+
+
+bool FrameWriter::open(const std::string& path)
+{
+    close();
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    isHeaderWritten_ = false;
+    timestamps_.clear();
+    return file_.is_open();
+}
+
+
+void FrameWriter::close()
+{
+    if (!file_.is_open()) return;
+
+    // インデックスを末尾に書き、ヘッダを確定させる
+    if (isHeaderWritten_) {
+        header_.frameCount  = static_cast<std::uint32_t>(timestamps_.size());
+        header_.indexOffset = header_.dataOffset + header_.frameStride * header_.frameCount;
+        file_.seekp(static_cast<std::streamoff>(header_.indexOffset));
+        if (!timestamps_.empty()) {
+            file_.write(reinterpret_cast<const char*>(&timestamps_[0]), timestamps_.size() * sizeof(std::int64_t));
+        }
+        file_.seekp(0);
+        file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    }
+    file_.close();
+}
+
+
+bool FrameWriter::isOpened() const
+{
+    return file_.is_open();
+}
+
+
+bool FrameWriter::write(const cv::Mat& frame, std::int64_t timestamp)
+{
+    if (!file_.is_open() || frame.empty()) return false;
+
+    const int depth = frame.depth();
+    if (depth != CV_8U && depth != CV_16U) return false;
+
+    // ヘッダは最初のフレームのサイズ / 型で書き出す
+    // フレーム数とインデックスの位置は close() で埋めるが、
+    // 途中で落ちてもフレームを読めるよう、ここでも有効なヘッダ（インデックス無し）を書いておく
+    if (!isHeaderWritten_) {
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, magic, sizeof(magic));
+        header_.version     = FrameFileHeader::CurrentVersion;
+        header_.rows        = frame.rows;
+        header_.cols        = frame.cols;
+        header_.type        = frame.type();
+        header_.frameStride = align(frameBytes(header_));
+        header_.dataOffset  = align(sizeof(header_));
+        padding_.assign(static_cast<std::size_t>(header_.frameStride - frameBytes(header_)), 0);
+
+        std::vector<char> headerBlock(static_cast<std::size_t>(header_.dataOffset), 0);
+        std::memcpy(&headerBlock[0], &header_, sizeof(header_));
+        file_.write(&headerBlock[0], headerBlock.size());
+        isHeaderWritten_ = true;
+    }
+
+    if (frame.rows != header_.rows || frame.cols != header_.cols || frame.type() != header_.type) {
+        return false;
+    }
+
+    if (frame.isContinuous()) {
+        file_.write(reinterpret_cast<const char*>(frame.data), static_cast<std::streamsize>(frameBytes(header_)));
+    } else {
+        const auto rowBytes = frame.cols * frame.elemSize();
+        for (int y = 0; y < frame.rows; ++y) {
+            file_.write(reinterpret_cast<const char*>(frame.ptr(y)), rowBytes);
+        }
+    }
+    if (!padding_.empty()) {
+        file_.write(&padding_[0], padding_.size());
+    }
+    timestamps_.push_back(timestamp);
+
+    return file_.good();
+}
+
+
+int FrameWriter::frameCount() const
+{
+    return static_cast<int>(timestamps_.size());
+}
+
+
+
+// ---
+
+
+
+FrameReader::FrameReader()
+    : data_(nullptr)
+    , timestamps_(nullptr)
+    , position_(0)
+{
+}
+
+
+FrameReader::~FrameReader()
+{
+    close();
+}
+
+
+bool FrameReader::open(const std::string& path)
+{
+    close();
+
+    file_.setFileName(QString::fromStdString(path));
+    if (!file_.open(QIODevice::ReadOnly)) return false;
+
+    const auto size = static_cast<std::uint64_t>(file_.size());
+    if (size < sizeof(header_)) {
+        close();
+        return false;
+    }
+
+    data_ = file_.map(0, file_.size());
+    if (!data_) {
+        close();
+        return false;
+    }
+
+    std::memcpy(&header_, data_, sizeof(header_));
+    const auto depth = CV_MAT_DEPTH(header_.type);
+    const bool isValidHeader =
+        std::memcmp(header_.magic, magic, sizeof(magic)) == 0 &&
+        header_.version == FrameFileHeader::CurrentVersion &&
+        header_.rows > 0 && header_.rows <= MaxSide &&
+        header_.cols > 0 && header_.cols <= MaxSide &&
+        (depth == CV_8U || depth == CV_16U) &&
+        header_.frameStride >= frameBytes(header_) &&
+        header_.dataOffset >= sizeof(header_) &&
+        header_.dataOffset <= size;
+    if (!isValidHeader) {
+        close();
+        return false;
+    }
+
+    // フレーム領域とインデックスがファイルに収まっているか（足し算があふれないよう引き算で比べる）
+    if (header_.indexOffset != 0) {
+        const auto indexBytes = static_cast<std::uint64_t>(header_.frameCount) * sizeof(std::int64_t);
+        const bool isInside =
+            header_.frameCount <= INT_MAX &&
+            header_.indexOffset >= header_.dataOffset &&
+            header_.indexOffset <= size &&
+            indexBytes <= size - header_.indexOffset &&
+            header_.frameCount <= (header_.indexOffset - header_.dataOffset) / header_.frameStride;
+        if (!isInside) {
+            close();
+            return false;
+        }
+        timestamps_ = reinterpret_cast<const std::int64_t*>(data_ + header_.indexOffset);
+    } else {
+        // インデックスが無い（録画中に落ちた）ので、書けていたフレームだけ読む
+        const auto frames = (size - header_.dataOffset) / header_.frameStride;
+        header_.frameCount = static_cast<std::uint32_t>(std::min<std::uint64_t>(frames, INT_MAX));
+        timestamps_ = nullptr;
+    }
+    position_ = 0;
+
+    return true;
+}
+
+
+void FrameReader::close()
+{
+    if (data_) {
+        file_.unmap(const_cast<uchar*>(data_));
+        data_ = nullptr;
+    }
+    if (file_.isOpen()) {
+        file_.close();
+    }
+    timestamps_ = nullptr;
+    position_ = 0;
+}
+
+
+bool FrameReader::isOpened() const
+{
+    return data_ != nullptr;
+}
+
+
+cv::Mat FrameReader::frame(int index) const
+{
+    if (!data_ || index < 0 || index >= frameCount()) return cv::Mat();
+
+    const auto offset = header_.dataOffset + header_.frameStride * index;
+    return cv::Mat(header_.rows, header_.cols, header_.type, const_cast<uchar*>(data_ + offset));
+}
+
+
+std::int64_t FrameReader::timestamp(int index) const
+{
+    if (!data_ || index < 0 || index >= frameCount()) return 0;
+    if (!timestamps_) return index * FrameFileHeader::RecoveredFrameInterval;
+    return timestamps_[index];
+}
+
+
+bool FrameReader::read(cv::Mat& frame, std::int64_t& timestamp)
+{
+    if (position_ >= frameCount()) return false;
+
+    frame     = this->frame(position_);
+    timestamp = this->timestamp(position_);
+    ++position_;
+
+    return true;
+}
+
+
+void FrameReader::rewind()
+{
+    position_ = 0;
+}
+
+
+int FrameReader::frameCount() const
+{
+    return data_ ? static_cast<int>(header_.frameCount) : 0;
+}
+
+
+
+// ---
+
+
+
+void Littai::convertToBgr(const cv::Mat& frame, cv::Mat& output)
+{
+    // 16 bit の IR は KinectV2 と同じスケールで 8 bit に落とす
+    cv::Mat gray = frame;
+    if (frame.depth() == CV_16U) {
+        cv::convertScaleAbs(frame, gray, 1.0 / 255);
+    }
+
+    if (gray.channels() == 1) {
+        cv::cvtColor(gray, output, cv::COLOR_GRAY2BGR);
+    } else {
+        output = gray;
+    }
+}
@@ -0,0 +1,93 @@
+﻿#ifndef FRAME_FILE_H
+#define FRAME_FILE_H
+
+#include <opencv2/opencv.hpp>
+#include <QFile>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+namespace Littai
+{
+
+
+// 録画ファイルのフォーマット
+// [ヘッダ][生フレーム x N（固定ストライド）][タイムスタンプ (us) のインデックス x N]
+// フレームサイズ / 型はヘッダで固定（最初のフレームで決まる）
+// 各フレームはアラインされたオフセットから始まるので mmap したまま cv::Mat として参照できる
+// インデックスは閉じるときに書く。indexOffset が 0 のもの（録画中に落ちた）は
+// ファイルサイズからフレーム数を求め、タイムスタンプは RecoveredFrameInterval 間隔とみなす
+struct FrameFileHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t rows, cols, type;
+    std::uint32_t frameCount;
+    std::uint64_t frameStride;
+    std::uint64_t dataOffset;
+    std::uint64_t indexOffset;
+
+    static const std::uint32_t CurrentVersion = 2;
+    static const std::uint64_t Alignment = 64;
+    static const std::int64_t RecoveredFrameInterval = 1000000 / 30;
+};
+
+
+class FrameWriter
+{
+public:
+    FrameWriter();
+    ~FrameWriter();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpened() const;
+    bool write(const cv::Mat& frame, std::int64_t timestamp);
+    int frameCount() const;
+
+private:
+    std::ofstream file_;
+    FrameFileHeader header_;
+    std::vector<std::int64_t> timestamps_;
+    std::vector<char> padding_;
+    bool isHeaderWritten_;
+};
+
+
+// 読み出しはファイル全体をマップし、デコードもコピーもせずに
+// フレームを返す（返した cv::Mat は読み込み専用で close() まで有効）
+class FrameReader
+{
+public:
+    FrameReader();
+    ~FrameReader();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpened() const;
+    bool read(cv::Mat& frame, std::int64_t& timestamp);
+    void rewind();
+    int frameCount() const;
+
+    cv::Mat frame(int index) const;
+    std::int64_t timestamp(int index) const;
+
+private:
+    QFile file_;
+    const uchar* data_;
+    FrameFileHeader header_;
+    const std::int64_t* timestamps_;
+    int position_;
+};
+
+
+// 録画フレーム (8 / 16 bit、1 / 3 チャンネル) をパイプラインの入力 (8 bit BGR) に揃える
+// 既に BGR の場合はコピーせずにヘッダだけ共有する
+void convertToBgr(const cv::Mat& frame, cv::Mat& output);
+
+
+}
+
+#endif // FRAME_FILE_H
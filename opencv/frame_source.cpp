@@ -0,0 +1,78 @@
+﻿#include "frame_source.h"
+
+using namespace Littai;
+
+
+
+ReplaySource::ReplaySource(const std::string& path)
+{
+    reader_.open(path);
+}
+
+
+bool ReplaySource::isValid() const
+{
+    return reader_.frameCount() > 0;
+}
+
+
+bool ReplaySource::next(cv::Mat& frame)
+{
+    cv::Mat raw;
+    std::int64_t timestamp;
+    if (!reader_.read(raw, timestamp)) {
+        reader_.rewind();
+        if (!reader_.read(raw, timestamp)) return false;
+    }
+    convertToBgr(raw, frame);
+    return true;
+}
+
+
+
+// ---
+
+
+
+StillImageSource::StillImageSource(const std::string& path)
+    : image_(cv::imread(path))
+{
+}
+
+
+bool StillImageSource::isValid() const
+{
+    return !image_.empty();
+}
+
+
+bool StillImageSource::next(cv::Mat& frame)
+{
+    frame = image_;
+    return !frame.empty();
+}
+
+
+
+// ---
+
+
+
+CameraSource::CameraSource(int device)
+    : video_(device)
+{
+}
+
+
+bool CameraSource::isValid() const
+{
+    return video_.isOpened();
+}
+
+
+bool CameraSource::next(cv::Mat& frame)
+{
+    if (!video_.isOpened()) return false;
+    video_ >> frame;
+    return !frame.empty();
+}
@@ -0,0 +1,64 @@
+﻿#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include "frame_file.h"
+
+
+namespace Littai
+{
+
+
+// パイプラインに流すフレームの供給元（ベンチマークやヘッドレス実行で使う）
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+    virtual bool isValid() const = 0;
+    virtual bool next(cv::Mat& frame) = 0;
+};
+
+
+// 録画ファイルを最後まで読んだら先頭に戻って繰り返す
+class ReplaySource : public FrameSource
+{
+public:
+    explicit ReplaySource(const std::string& path);
+    bool isValid() const override;
+    bool next(cv::Mat& frame) override;
+
+private:
+    FrameReader reader_;
+};
+
+
+// 1 枚の画像を繰り返し流す
+class StillImageSource : public FrameSource
+{
+public:
+    explicit StillImageSource(const std::string& path);
+    bool isValid() const override;
+    bool next(cv::Mat& frame) override;
+
+private:
+    cv::Mat image_;
+};
+
+
+// cv::VideoCapture のカメラから読む
+class CameraSource : public FrameSource
+{
+public:
+    explicit CameraSource(int device);
+    bool isValid() const override;
+    bool next(cv::Mat& frame) override;
+
+private:
+    cv::VideoCapture video_;
+};
+
+
+}
+
+#endif // FRAME_SOURCE_H
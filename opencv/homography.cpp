@@ -12,6 +12,12 @@ Homography::Homography(QQuickItem *parent)
 }
 
 
+Homography::~Homography()
+{
+    detachFromPipeline();
+}
+
+
 void Homography::setImage(const QVariant& image)
 {
     if (srcPoints_.empty()) {
@@ -19,34 +25,38 @@ void Homography::setImage(const QVariant& image)
         return;
     }
 
-    const cv::Mat srcImage = image.value<cv::Mat>();
-    const int width  = (width_  <= 0) ? srcImage.rows : width_;
-    const int height = (height_ <= 0) ? srcImage.cols : height_;
-    cv::Mat destImage(width, height, srcImage.type());
+    updateParams();
 
-    std::vector<double> srcPointVec;
-    for (const QVariant& data : srcPoints_) {
-        const auto p = data.value<QVariantList>();
-        const auto x = p[0].value<double>();
-        const auto y = p[1].value<double>();
-        srcPointVec.push_back(x * srcImage.cols);
-        srcPointVec.push_back(y * srcImage.rows);
-    }
+    cv::Mat destImage;
+    engine_.process(image.value<cv::Mat>(), destImage);
 
-    double destPointArray[] = {
-        0.0,                  0.0,
-        destImage.cols - 1.0, 0.0,
-        destImage.cols - 1.0, destImage.rows - 1.0,
-        0.0,                  destImage.rows - 1.0
-    };
+    Image::setImage(destImage);
 
-    const cv::Mat srcPoints(srcPoints_.length(),  2, CV_64FC1, &srcPointVec[0]);
-    const cv::Mat destPoints(srcPoints_.length(), 2, CV_64FC1, destPointArray);
+    emit imageChanged();
+}
 
-    const auto homographyMat = cv::findHomography(srcPoints, destPoints);
-    cv::warpPerspective(srcImage, destImage, homographyMat, destImage.size());
 
-    Image::setImage(destImage);
+Stage& Homography::stage()
+{
+    return engine_;
+}
+
 
+void Homography::updateParams()
+{
+    std::vector<cv::Point2d> srcPoints;
+    for (const QVariant& data : srcPoints_) {
+        const auto p = data.value<QVariantList>();
+        srcPoints.push_back(cv::Point2d(p[0].value<double>(), p[1].value<double>()));
+    }
+    engine_.setSrcPoints(srcPoints);
+    engine_.setOutputSize(width_, height_);
+}
+
+
+void Homography::setOutput(const cv::Mat& output)
+{
+    Image::setImage(output, false);
     emit imageChanged();
+    QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection);
 }
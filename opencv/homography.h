@@ -3,12 +3,14 @@
 
 #include <QVariantList>
 #include "image.h"
+#include "homography_engine.h"
+#include "pipeline_stage.h"
 
 
 namespace Littai
 {
 
-class Homography : public Image
+class Homography : public Image, public PipelineStage
 {
     Q_OBJECT
     Q_PROPERTY(QVariant image READ image WRITE setImage NOTIFY imageChanged)
@@ -18,9 +20,15 @@ class Homography : public Image
 
 public:
     explicit Homography(QQuickItem* parent = nullptr);
+    ~Homography();
     void setImage(const QVariant& image);
 
+    Stage& stage() override;
+    void updateParams() override;
+    void setOutput(const cv::Mat& output) override;
+
 private:
+    HomographyEngine engine_;
     QVariantList srcPoints_;
     int width_, height_;
 
@@ -0,0 +1,83 @@
+﻿#include "homography_engine.h"
+
+using namespace Littai;
+
+
+
+HomographyEngine::HomographyEngine()
+    : width_(-1)
+    , height_(-1)
+    , isDirty_(true)
+{
+}
+
+
+std::string HomographyEngine::name() const
+{
+    return "homography";
+}
+
+
+void HomographyEngine::setSrcPoints(const std::vector<cv::Point2d>& points)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (srcPoints_ == points) return;
+    srcPoints_ = points;
+    isDirty_ = true;
+}
+
+
+void HomographyEngine::setOutputSize(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (width_ == width && height_ == height) return;
+    width_  = width;
+    height_ = height;
+    isDirty_ = true;
+}
+
+
+void HomographyEngine::process(const cv::Mat& input, cv::Mat& output)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (input.empty()) {
+        output.release();
+        return;
+    }
+
+    if (srcPoints_.empty()) {
+        input.copyTo(output);
+        return;
+    }
+
+    const int width  = (width_  <= 0) ? input.rows : width_;
+    const int height = (height_ <= 0) ? input.cols : height_;
+    const cv::Size outputSize(height, width);
+
+    if (isDirty_ || input.size() != inputSize_ || outputSize != outputSize_) {
+        std::vector<double> srcPointVec;
+        for (const auto& p : srcPoints_) {
+            srcPointVec.push_back(p.x * input.cols);
+            srcPointVec.push_back(p.y * input.rows);
+        }
+
+        double destPointArray[] = {
+            0.0,                       0.0,
+            outputSize.width - 1.0,    0.0,
+            outputSize.width - 1.0,    outputSize.height - 1.0,
+            0.0,                       outputSize.height - 1.0
+        };
+
+        const int n = static_cast<int>(srcPoints_.size());
+        const cv::Mat srcPoints(n,  2, CV_64FC1, &srcPointVec[0]);
+        const cv::Mat destPoints(n, 2, CV_64FC1, destPointArray);
+
+        homography_ = cv::findHomography(srcPoints, destPoints);
+        inputSize_  = input.size();
+        outputSize_ = outputSize;
+        isDirty_    = false;
+    }
+
+    cv::warpPerspective(input, output, homography_, outputSize_);
+}
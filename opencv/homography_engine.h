@@ -0,0 +1,39 @@
+﻿#ifndef HOMOGRAPHY_ENGINE_H
+#define HOMOGRAPHY_ENGINE_H
+
+#include "stage.h"
+#include <vector>
+#include <mutex>
+
+
+namespace Littai
+{
+
+
+class HomographyEngine : public Stage
+{
+public:
+    HomographyEngine();
+
+    // 入力画像の大きさで正規化された (0 - 1) 4 隅の座標
+    void setSrcPoints(const std::vector<cv::Point2d>& points);
+    void setOutputSize(int width, int height);
+
+    std::string name() const override;
+    void process(const cv::Mat& input, cv::Mat& output) override;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<cv::Point2d> srcPoints_;
+    int width_, height_;
+
+    // 4 隅と入出力サイズが変わらない限り変換行列は使い回す
+    cv::Mat homography_;
+    cv::Size inputSize_, outputSize_;
+    bool isDirty_;
+};
+
+
+}
+
+#endif // HOMOGRAPHY_ENGINE_H
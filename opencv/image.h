@@ -6,8 +6,7 @@
 #include <QPainter>
 #include <opencv2/opencv.hpp>
 #include <mutex>
-
-Q_DECLARE_METATYPE(cv::Mat)
+#include "mat_metatype.h"
 
 
 namespace Littai
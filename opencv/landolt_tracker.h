@@ -2,47 +2,16 @@
 #define LANDOLT_TRACKER_H
 
 #include "image.h"
-#include <thread>
-#include <list>
+#include "landolt_tracker_engine.h"
+#include "stage_worker.h"
+#include "pipeline_stage.h"
 
 
 namespace Littai
 {
 
-struct TrackedItem
-{
-    unsigned int id;
-    double x, y;
-    double width, height;
-    double radius;
-    double angle;
-    int frameCount;
-    bool checked;
-    cv::Mat image;
-
-    cv::Mat touchImage;
-    double touchX, touchY;
-    bool touched;
-    int touchCount;
-
-    TrackedItem()
-        : id(-1), x(0), y(0), width(0), height(0), radius(0), angle(0)
-        , frameCount(0), checked(false)
-        , touchX(0), touchY(0), touched(false), touchCount(0)
-    {
-    }
-
-    static unsigned int GetId()
-    {
-        return currentId++;
-    }
-
-private:
-    static int currentId;
-};
-
 
-class LandoltTracker : public Image
+class LandoltTracker : public Image, public PipelineStage
 {
     Q_OBJECT
     Q_PROPERTY(QVariant inputImage WRITE setInputImage READ inputImage NOTIFY inputImageChanged)
@@ -51,6 +20,12 @@ class LandoltTracker : public Image
     Q_PROPERTY(int contrastThreshold MEMBER contrastThreshold_ NOTIFY contrastThresholdChanged)
     Q_PROPERTY(int touchContrastThreshold MEMBER touchContrastThreshold_ NOTIFY touchContrastThresholdChanged)
     Q_PROPERTY(double templateThreshold MEMBER templateThreshold_ NOTIFY templateThresholdChanged)
+    Q_PROPERTY(QVariantList templateScales MEMBER templateScales_ NOTIFY templateScalesChanged)
+    Q_PROPERTY(int maxItems MEMBER maxItems_ NOTIFY maxItemsChanged)
+    Q_PROPERTY(QString matchMethod MEMBER matchMethod_ NOTIFY matchMethodChanged)
+    Q_PROPERTY(QString usedMatchMethod READ usedMatchMethod NOTIFY itemsChanged)
+    Q_PROPERTY(double trackingDistance MEMBER trackingDistance_ NOTIFY trackingDistanceChanged)
+    Q_PROPERTY(int lostFrames MEMBER lostFrames_ NOTIFY lostFramesChanged)
     Q_PROPERTY(bool isOutputImage MEMBER isOutputImage_ NOTIFY isOutputImageChanged)
     Q_PROPERTY(int fps MEMBER fps_ NOTIFY fpsChanged)
     Q_PROPERTY(int touchThreshold MEMBER touchThreshold_ NOTIFY touchThresholdChanged)
@@ -58,44 +33,50 @@ class LandoltTracker : public Image
 public:
     explicit LandoltTracker(QQuickItem *parent = 0);
     ~LandoltTracker();
-    void updateItems(const std::vector<TrackedItem>& currentItems);
 
     void setInputImage(const QVariant& image);
     QVariant inputImage() const;
     void setTemplateImage(const QVariant& image);
     QVariant templateImage() const;
     QVariantList items();
+    QString usedMatchMethod() const;
 
-private:
-    void track();
-    void preProcess(cv::Mat& image);
-    void detectLandolt(cv::Mat& outputImage, cv::Mat& inputImage);
-    void detectLandoltTouch(cv::Mat& outputImage, cv::Mat& inputImage);
+    Stage& stage() override;
+    void updateParams() override;
+    void setOutput(const cv::Mat& output) override;
 
-    std::thread thread_;
-    mutable std::mutex mutex_;
-    bool isFinished_;
+private:
+    LandoltTrackerEngine engine_;
+    StageWorker worker_;
 
     bool isOutputImage_;
 
     cv::Mat inputImage_;
     cv::Mat templateImage_;
-    bool isImageUpdated_;
+    mutable std::mutex mutex_;
+    cv::Size outputSize_;
 
     int contrastThreshold_;
     int touchContrastThreshold_;
     double templateThreshold_;
-    double radius_;
+    QVariantList templateScales_;
+    int maxItems_;
+    QString matchMethod_;
+    double trackingDistance_;
+    int lostFrames_;
     int fps_;
 
     int touchThreshold_;
 
-    std::vector<TrackedItem> items_;
-
 signals:
     void inputImageChanged() const;
     void templateImageChanged() const;
     void templateThresholdChanged() const;
+    void templateScalesChanged() const;
+    void maxItemsChanged() const;
+    void matchMethodChanged() const;
+    void trackingDistanceChanged() const;
+    void lostFramesChanged() const;
     void contrastThresholdChanged() const;
     void touchContrastThresholdChanged() const;
     void touchThresholdChanged() const;
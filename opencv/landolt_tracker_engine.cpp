@@ -0,0 +1,637 @@
+﻿#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include "landolt_tracker_engine.h"
+#include "work_stealing_pool.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // 解像度の関係でサイズを半分にする必要あり？（要調査）
+    const double shrinkScale = 0.3;
+}
+
+
+
+int TrackedItem::currentId = 0;
+
+
+LandoltTrackerEngine::LandoltTrackerEngine()
+{
+}
+
+
+std::string LandoltTrackerEngine::name() const
+{
+    return "landolt";
+}
+
+
+void LandoltTrackerEngine::setParams(const Params& params)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    params_ = params;
+}
+
+
+LandoltTrackerEngine::Params LandoltTrackerEngine::params() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return params_;
+}
+
+
+void LandoltTrackerEngine::setTemplateImage(const cv::Mat& image)
+{
+    // 処理中のフレームが参照しているバッファは書き換えない
+    const auto templateImage = image.clone();
+    std::lock_guard<std::mutex> lock(mutex_);
+    templateImage_ = templateImage;
+}
+
+
+cv::Mat LandoltTrackerEngine::templateImage() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return templateImage_;
+}
+
+
+std::vector<TrackedItem> LandoltTrackerEngine::items() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publishedItems_;
+}
+
+
+std::string LandoltTrackerEngine::matchMethod() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publishedMatchMethod_;
+}
+
+
+void LandoltTrackerEngine::process(const cv::Mat& input, cv::Mat& output)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        currentParams_        = params_;
+        currentTemplateImage_ = templateImage_;
+    }
+
+    if (input.empty() || currentTemplateImage_.empty()) {
+        output.release();
+        return;
+    }
+
+    cv::Mat grayInput, grayInputRaw;
+    cv::cvtColor(input, grayInput, cv::COLOR_BGR2GRAY);
+    grayInputRaw = grayInput.clone();
+
+    // フィルタ
+    preProcess(grayInput);
+
+    // 出力画像
+    cv::cvtColor(grayInput, output, cv::COLOR_GRAY2BGR);
+
+    // ランドルト環検出
+    detectLandolt(output, grayInput);
+
+    // タッチ検出
+    detectLandoltTouch(output, grayInputRaw);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        publishedItems_ = items_;
+        publishedMatchMethod_ = matchMethod_;
+    }
+}
+
+
+void LandoltTrackerEngine::preProcess(cv::Mat &image)
+{
+    cv::threshold(image, image, currentParams_.contrastThreshold, 255, cv::THRESH_BINARY);
+    cv::medianBlur(image, image, 3);
+    cv::dilate(image, image, cv::Mat(), cv::Point(-1, -1), 1);
+}
+
+
+void LandoltTrackerEngine::updateTemplateCache()
+{
+    if (cachedTemplateImage_.data == currentTemplateImage_.data &&
+        cachedTemplateScales_ == currentParams_.templateScales) {
+        return;
+    }
+
+    cv::Mat grayTemplate;
+    cv::cvtColor(currentTemplateImage_, grayTemplate, cv::COLOR_BGR2GRAY);
+
+    scaledTemplates_.clear();
+    for (const auto scale : currentParams_.templateScales) {
+        if (scale <= 0) continue;
+        cv::Mat image;
+        cv::resize(grayTemplate, image, cv::Size(), shrinkScale / 2 * scale, shrinkScale / 2 * scale, cv::INTER_LINEAR);
+        if (image.empty()) continue;
+        ScaledTemplate scaled;
+        scaled.scale = scale;
+        scaled.size  = cv::Point(image.rows / shrinkScale, image.cols / shrinkScale);
+        scaled.templateScale = (image.rows / shrinkScale + image.cols / shrinkScale) / 2;
+        scaled.matcher.setTemplate(image);
+
+        // レイの表は大きさが同じなら倍率が変わっても使い回す
+        auto& polarTable = polarTables_[std::make_pair(scaled.size.x, scaled.size.y)];
+        if (!polarTable) {
+            polarTable = createPolarTable(scaled.size, scaled.templateScale);
+        }
+        scaled.polarTable = polarTable;
+        scaledTemplates_.push_back(scaled);
+    }
+
+    cachedTemplateImage_  = currentTemplateImage_;
+    cachedTemplateScales_ = currentParams_.templateScales;
+}
+
+
+void LandoltTrackerEngine::detectLandolt(cv::Mat &outputImage, cv::Mat &inputImage)
+{
+    updateTemplateCache();
+
+    cv::Mat grayInputSmall;
+    cv::resize(inputImage, grayInputSmall, cv::Size(), shrinkScale, shrinkScale, cv::INTER_LINEAR);
+
+    // 倍率ごとに Template Matching を行い、応答マップの極大をすべて候補にする
+    // 大きいテンプレートは周波数領域で相関を取る
+    std::vector<LandoltCandidate> peaks;
+    matchMethod_.clear();
+    for (auto& scaled : scaledTemplates_) {
+        const auto& grayTemplate = scaled.matcher.templateImage();
+        if (grayTemplate.cols > grayInputSmall.cols || grayTemplate.rows > grayInputSmall.rows) {
+            continue;
+        }
+
+        cv::Mat result;
+        const auto method = scaled.matcher.match(grayInputSmall, result, currentParams_.matchMethod);
+        if (!matchMethod_.empty()) matchMethod_ += ",";
+        matchMethod_ += TemplateMatcher::methodName(method);
+
+        const auto templateScale = scaled.templateScale;
+
+        // 非極大値抑制：近傍（テンプレートの 0.75 倍）で最大かつ閾値以上の点だけ残す
+        const int r = std::max(1, cvRound(templateScale * shrinkScale * 0.75));
+        const auto kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * r + 1, 2 * r + 1));
+        cv::Mat dilated;
+        cv::dilate(result, dilated, kernel);
+        const cv::Mat isPeak = (result >= dilated) & (result >= currentParams_.templateThreshold);
+
+        std::vector<cv::Point> positions;
+        if (cv::countNonZero(isPeak) > 0) {
+            cv::findNonZero(isPeak, positions);
+        }
+        for (const auto& position : positions) {
+            LandoltCandidate candidate;
+            candidate.position = position * (1 / shrinkScale);
+            candidate.size     = scaled.size;
+            candidate.scale    = templateScale;
+            candidate.score    = result.at<float>(position);
+            candidate.polarTable = scaled.polarTable.get();
+            peaks.push_back(candidate);
+        }
+    }
+
+    // 倍率をまたいで重なったものは応答の高いほうを残す
+    std::sort(peaks.begin(), peaks.end(), [](const LandoltCandidate& a, const LandoltCandidate& b) {
+        return a.score > b.score;
+    });
+
+    std::vector<LandoltCandidate> candidates;
+    for (const auto& peak : peaks) {
+        if (static_cast<int>(candidates.size()) >= currentParams_.maxItems) break;
+
+        // 外側のものは無視
+        const auto& maxPos = peak.position;
+        if (maxPos.x < 0 || maxPos.x + peak.size.x >= inputImage.cols ||
+            maxPos.y < 0 || maxPos.y + peak.size.y >= inputImage.rows) {
+            continue;
+        }
+
+        bool isOverlapped = false;
+        const auto center = cv::Point2d(maxPos) + cv::Point2d(peak.size) * 0.5;
+        for (const auto& candidate : candidates) {
+            const auto otherCenter = cv::Point2d(candidate.position) + cv::Point2d(candidate.size) * 0.5;
+            const auto d = center - otherCenter;
+            if (std::sqrt(d.dot(d)) < std::max(peak.scale, candidate.scale) * 0.75) {
+                isOverlapped = true;
+                break;
+            }
+        }
+        if (isOverlapped) continue;
+
+        // 認識したパターンを赤い四角で表示
+        if (currentParams_.isOutputImage) {
+            cv::rectangle(
+                outputImage,
+                maxPos,
+                maxPos + peak.size,
+                CV_RGB(255, 0, 0),
+                2);
+        }
+
+        candidates.push_back(peak);
+    }
+
+    // 候補ごとの解析（レイキャスト）はプールで並列に行う
+    WorkStealingPool::shared().parallelFor(static_cast<int>(candidates.size()), [&](int i) {
+        analyzeLandolt(candidates[i], inputImage);
+    });
+
+    // 描画と登録は元の順番で行う
+    std::vector<TrackedItem> items;
+    for (const auto& candidate : candidates) {
+        const auto& maxPos = candidate.position;
+        const auto templateScale = candidate.scale;
+        const int centerX = candidate.size.x / 2;
+        const int centerY = candidate.size.y / 2;
+
+        if (currentParams_.isOutputImage) {
+            // レイを飛ばした場所は赤く塗っておく
+            for (const auto& point : candidate.rayPoints) {
+                outputImage.at<cv::Vec3b>(maxPos.y + point.y, maxPos.x + point.x) = cv::Vec3b(0, 0, 255);
+            }
+            // 重心に○を描く
+            cv::circle(outputImage, maxPos + cv::Point(centerX, centerY), 3, CV_RGB(0, 255, 0), -1);
+        }
+
+        if (candidate.holeCount > 0) {
+            // 中心点（TODO: 重心位置でなく実際の中心にする）
+            const auto center = maxPos + cv::Point(centerX, centerY);
+
+            const auto averageHoleAngle = candidate.holeAngle;
+            const auto radius = candidate.radius;
+
+            // 認識した角度を示す矢印を描く
+            if (currentParams_.isOutputImage) {
+                const auto dir = cv::Point(
+                    static_cast<int>(templateScale / 2 * cos(averageHoleAngle)),
+                    static_cast<int>(templateScale / 2 * sin(averageHoleAngle)));
+                cv::arrowedLine(outputImage, center, center + dir, CV_RGB(0, 255, 0), 1);
+            }
+
+            // トラッキング情報を登録
+            TrackedItem item;
+            item.x      = center.x;
+            item.y      = center.y;
+            item.width  = candidate.size.x;
+            item.height = candidate.size.y;
+            item.angle  = averageHoleAngle;
+            item.radius = radius;
+            item.image  = outputImage(cv::Rect(
+                center - cv::Point(templateScale / 2, templateScale / 2),
+                center + cv::Point(templateScale / 2, templateScale / 2))).clone();
+            items.push_back(item);
+        }
+    }
+
+    // トラッキング情報を更新する
+    updateItems(items);
+}
+
+
+void LandoltTrackerEngine::analyzeLandolt(LandoltCandidate& candidate, const cv::Mat& inputImage) const
+{
+    const auto& templateSize = candidate.size;
+    const auto templateScale = candidate.scale;
+
+    // 認識した場所を ROI で区切る
+    // （他の候補と重なることがあるので複製してから書き込む）
+    auto roi = inputImage(cv::Rect(candidate.position, candidate.position + templateSize)).clone();
+
+    // 重心点（~ ランドルト環の中心）を求める
+    // （実際は穴の空いてる位置から若干離れる位置に来る）
+    /*
+    std::vector<cv::Mat> contours;
+    cv::findContours(roi, contours, cv::RETR_EXTERNAL, 2);
+    auto moments = cv::moments(contours[0]);
+    if (moments.m00 == 0) continue;
+    const int centerX = moments.m10 / moments.m00;
+    const int centerY = moments.m01 / moments.m00;
+    */
+    const int centerX = templateSize.x / 2;
+    const int centerY = templateSize.y / 2;
+
+    // 前処理として真ん中を埋めておく
+    // （タッチされた時に真ん中が白くなるのをキャンセルするため）
+    cv::circle(roi, cv::Point(centerX, centerY), templateScale * 0.3, cv::Scalar(0, 0, 0), -1);
+
+    // ランドルト環の中心から放射状にレイを飛ばし、
+    // 通り抜けたレイの平均角度を認識したアイテムの回転角とする
+    // （サンプル位置は表から引くので、レイごとに連続したオフセットを見るだけになる）
+    const auto& table = *candidate.polarTable;
+    const auto* pixels = roi.ptr<unsigned char>();
+    const int div = static_cast<int>(table.cosTable.size());
+
+    double holeCos = 0, holeSin = 0;
+    double radiusSum = 0;
+    int holeCount = 0, hitCount = 0;
+
+    for (int i = 0; i < div; ++i) {
+        const int begin = table.rayBegin[i];
+        const int end   = table.rayBegin[i + 1];
+
+        // だんだんと半径を大きくしていき、最初にヒットしたところで止める
+        int k = begin;
+        while (k < end && pixels[table.offsets[k]] == 0) {
+            ++k;
+        }
+
+        if (currentParams_.isOutputImage) {
+            candidate.rayPoints.insert(candidate.rayPoints.end(), table.points.begin() + begin, table.points.begin() + k);
+        }
+
+        if (k < end) {
+            radiusSum += table.radiuses[k];
+            ++hitCount;
+        } else {
+            // ROI の端まで到達したレイの角度は単位ベクトルで足し合わせる
+            // （0 - 360 の境界をまたいでも補正がいらない）
+            holeCos += table.cosTable[i];
+            holeSin += table.sinTable[i];
+            ++holeCount;
+        }
+    }
+
+    candidate.holeCount = holeCount;
+    candidate.holeAngle = 0;
+    if (holeCount > 0) {
+        auto angle = std::atan2(holeSin, holeCos);
+        if (angle < 0) angle += 2 * M_PI;
+        candidate.holeAngle = angle;
+    }
+    candidate.radius = (hitCount > 0) ? radiusSum / hitCount : -1.0;
+}
+
+
+std::shared_ptr<const LandoltTrackerEngine::PolarTable> LandoltTrackerEngine::createPolarTable(const cv::Point& size, double templateScale)
+{
+    auto table = std::make_shared<PolarTable>();
+    const int div = 120;
+    const int centerX = size.x / 2;
+    const int centerY = size.y / 2;
+
+    for (int i = 0; i < div; ++i) {
+        const auto angle = 2 * M_PI * i / div;
+        table->cosTable.push_back(cos(angle));
+        table->sinTable.push_back(sin(angle));
+        table->rayBegin.push_back(static_cast<int>(table->offsets.size()));
+
+        // ROI の外に出たらそのレイは終わり
+        for (int r = 0; r < templateScale; r += 3) {
+            int x = centerX + r * cos(angle);
+            int y = centerY + r * sin(angle);
+            if (x < 0 || y < 0 || x >= size.x || y >= size.y) {
+                break;
+            }
+            table->offsets.push_back(y * size.x + x);
+            table->radiuses.push_back(r);
+            table->points.push_back(cv::Point(x, y));
+        }
+    }
+    table->rayBegin.push_back(static_cast<int>(table->offsets.size()));
+
+    return table;
+}
+
+
+void LandoltTrackerEngine::updateItems(const std::vector<TrackedItem>& currentItems)
+{
+    const auto maxDistance = currentParams_.trackingDistance;
+
+    // 検出結果を trackingDistance 四方のグリッドに振り分けておく
+    // （予測位置の周り 3x3 マスだけ見れば足りる）
+    const double cellSize = std::max(maxDistance, 1.0);
+    std::map<std::pair<int, int>, std::vector<int>> grid;
+    for (int j = 0; j < static_cast<int>(currentItems.size()); ++j) {
+        const auto cell = std::make_pair(
+            static_cast<int>(std::floor(currentItems[j].x / cellSize)),
+            static_cast<int>(std::floor(currentItems[j].y / cellSize)));
+        grid[cell].push_back(j);
+    }
+
+    // 既存のアイテムの予測位置と検出結果の組を距離つきで列挙
+    struct Pair
+    {
+        double distance;
+        int item, current;
+    };
+    std::vector<Pair> pairs;
+    for (int i = 0; i < static_cast<int>(items_.size()); ++i) {
+        const auto& item = items_[i];
+        // 見失っている間も速度ぶん進んでいるとみなす
+        const auto frames = item.lostCount + 1;
+        const auto px = item.x + item.vx * frames;
+        const auto py = item.y + item.vy * frames;
+        const int cx = static_cast<int>(std::floor(px / cellSize));
+        const int cy = static_cast<int>(std::floor(py / cellSize));
+        for (int gy = cy - 1; gy <= cy + 1; ++gy) {
+            for (int gx = cx - 1; gx <= cx + 1; ++gx) {
+                const auto it = grid.find(std::make_pair(gx, gy));
+                if (it == grid.end()) continue;
+                for (const auto j : it->second) {
+                    const auto dx = currentItems[j].x - px;
+                    const auto dy = currentItems[j].y - py;
+                    const auto distance = sqrt(dx * dx + dy * dy);
+                    if (distance < maxDistance) {
+                        Pair pair = { distance, i, j };
+                        pairs.push_back(pair);
+                    }
+                }
+            }
+        }
+    }
+
+    // 近い組から順に割り当てる（1 つの検出結果は 1 つのアイテムにだけ対応させる）
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) {
+        return a.distance < b.distance;
+    });
+
+    for (auto&& item : items_) {
+        item.checked = false;
+    }
+    std::vector<bool> isAssigned(currentItems.size(), false);
+    for (const auto& pair : pairs) {
+        auto& item = items_[pair.item];
+        if (item.checked || isAssigned[pair.current]) continue;
+
+        // 見失っていた間の移動も含めて速度を更新
+        const auto& currentItem = currentItems[pair.current];
+        const auto frames = item.lostCount + 1;
+        item.vx += ((currentItem.x - item.x) / frames - item.vx) * 0.5;
+        item.vy += ((currentItem.y - item.y) / frames - item.vy) * 0.5;
+
+        item.x          = currentItem.x;
+        item.y          = currentItem.y;
+        item.width      = currentItem.width;
+        item.height     = currentItem.height;
+        item.radius     = currentItem.radius;
+        item.angle      = currentItem.angle;
+        item.image      = currentItem.image;
+        item.touchImage = currentItem.touchImage;
+        item.checked    = true;
+        isAssigned[pair.current] = true;
+    }
+
+    // しばらく認識されなかったアイテムは削除
+    // 認識されたアイテムはフレームカウントを増加
+    for (auto it = items_.begin(); it != items_.end();) {
+        auto& item = *it;
+        if (item.checked) {
+            item.lostCount = 0;
+            ++item.frameCount;
+        } else {
+            ++item.lostCount;
+            if (item.lostCount > currentParams_.lostFrames) {
+                it = items_.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+
+    // 新規アイテムを追加
+    for (int j = 0; j < static_cast<int>(currentItems.size()); ++j) {
+        if (isAssigned[j]) continue;
+        auto item = currentItems[j];
+        item.id = TrackedItem::GetId();
+        items_.push_back(item);
+    }
+}
+
+
+void LandoltTrackerEngine::detectLandoltTouch(cv::Mat &outputImage, cv::Mat &inputImage)
+{
+    // 円内の平均は積分画像から行ごとの区間和で求める
+    cv::integral(inputImage, touchIntegral_, CV_32S);
+
+    // アイテムごとに独立しているのでプールで並列に行う
+    // 見失っている間のアイテムは前の位置で調べず、タッチも解除しておく
+    WorkStealingPool::shared().parallelFor(static_cast<int>(items_.size()), [&](int i) {
+        auto& item = items_[i];
+        if (item.lostCount > 0) {
+            item.touched = false;
+            item.touchCount = 0;
+            item.touchX = 0;
+            item.touchY = 0;
+            return;
+        }
+        detectTouch(item, inputImage);
+    });
+}
+
+
+void LandoltTrackerEngine::detectTouch(TrackedItem& item, const cv::Mat& inputImage) const
+{
+    const cv::Rect rect(
+        cv::Point(item.x - item.width / 2, item.y - item.height / 2),
+        cv::Point(item.x + item.width / 2, item.y + item.height / 2));
+    const cv::Mat roi = inputImage(rect);
+
+    // 円形マスク：y 行目は [x0, x1] の区間だけが円の内側
+    const auto r = item.radius * 0.6;
+    const int centerX = roi.cols / 2;
+    const int centerY = roi.rows / 2;
+    auto span = [&](int y, int& x0, int& x1) -> bool {
+        const int cy = y - centerY;
+        const double limit = r * r - cy * cy;
+        if (limit < 0) return false;
+        int m = static_cast<int>(std::sqrt(limit));
+        while ((m + 1) * (m + 1) <= limit) ++m;
+        while (m > 0 && m * m > limit) --m;
+        x0 = std::max(centerX - m, 0);
+        x1 = std::min(centerX + m, roi.cols - 1);
+        return x0 <= x1;
+    };
+
+    // 円内の平均
+    long long sum = 0;
+    int n = 0;
+    for (int y = 0; y < roi.rows; ++y) {
+        int x0, x1;
+        if (!span(y, x0, x1)) continue;
+        const auto* top    = touchIntegral_.ptr<int>(rect.y + y);
+        const auto* bottom = touchIntegral_.ptr<int>(rect.y + y + 1);
+        const int left  = rect.x + x0;
+        const int right = rect.x + x1 + 1;
+        sum += bottom[right] - bottom[left] - top[right] + top[left];
+        n += x1 - x0 + 1;
+    }
+    const int average = (n > 0) ? static_cast<int>(sum / n) : 0;
+
+    // 平均との差を二値化（円の外は 0）
+    const int threshold = average + currentParams_.touchContrastThreshold;
+    item.touchBinary.create(roi.size(), CV_8UC1);
+    for (int y = 0; y < roi.rows; ++y) {
+        const auto* in = roi.ptr<unsigned char>(y);
+        auto* out = item.touchBinary.ptr<unsigned char>(y);
+        int x0, x1;
+        if (!span(y, x0, x1)) {
+            std::fill(out, out + roi.cols, 0);
+            continue;
+        }
+        std::fill(out, out + x0, 0);
+        for (int x = x0; x <= x1; ++x) {
+            out[x] = (in[x] > threshold) ? 255 : 0;
+        }
+        std::fill(out + x1 + 1, out + roi.cols, 0);
+    }
+    cv::medianBlur(item.touchBinary, item.touchBlurred, 5);
+
+    // 全体の平均と円内の重心を 1 回で数える
+    const auto& blurred = item.touchBlurred;
+    long long mx = 0, my = 0, total = 0, all = 0;
+    for (int y = 0; y < blurred.rows; ++y) {
+        const auto* p = blurred.ptr<unsigned char>(y);
+        int rowAll = 0;
+        for (int x = 0; x < blurred.cols; ++x) {
+            rowAll += p[x];
+        }
+        all += rowAll;
+
+        int x0, x1;
+        if (!span(y, x0, x1)) continue;
+        int rowTotal = 0, rowX = 0;
+        for (int x = x0; x <= x1; ++x) {
+            rowTotal += p[x];
+            rowX     += p[x] * x;
+        }
+        total += rowTotal;
+        mx    += rowX;
+        my    += static_cast<long long>(rowTotal) * y;
+    }
+    const double cx = (total > 0) ? static_cast<double>(mx) / total : centerX;
+    const double cy = (total > 0) ? static_cast<double>(my) / total : centerY;
+    const double averageValue = static_cast<double>(all) / blurred.total();
+
+    // 表示用の画像は出力するときだけ作る
+    if (currentParams_.isOutputImage) {
+        cv::cvtColor(blurred, item.touchImage, cv::COLOR_GRAY2BGR);
+    }
+
+    if (averageValue > currentParams_.touchThreshold) {
+        if (currentParams_.isOutputImage) {
+            cv::circle(item.touchImage, cv::Point(cx, cy), 5, cv::Scalar(0, 0, 255), 2);
+        }
+        ++item.touchCount;
+        if (item.touchCount > 2) {
+            item.touched = true;
+            item.touchX = (cx - centerX) / r;
+            item.touchY = (cy - centerY) / r;
+        }
+    } else {
+        item.touched = false;
+        item.touchCount = 0;
+        item.touchX = 0;
+        item.touchY = 0;
+    }
+}
@@ -0,0 +1,158 @@
+﻿#ifndef LANDOLT_TRACKER_ENGINE_H
+#define LANDOLT_TRACKER_ENGINE_H
+
+#include "stage.h"
+#include "template_matcher.h"
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+
+namespace Littai
+{
+
+struct TrackedItem
+{
+    unsigned int id;
+    double x, y;
+    double width, height;
+    double radius;
+    double angle;
+    double vx, vy;    // 1 フレームあたりの移動量
+    int frameCount;
+    int lostCount;
+    bool checked;
+    cv::Mat image;
+
+    cv::Mat touchImage;
+    double touchX, touchY;
+    bool touched;
+    int touchCount;
+
+    // タッチ検出の作業用（同じアイテムならフレームをまたいで使い回す）
+    cv::Mat touchBinary, touchBlurred;
+
+    TrackedItem()
+        : id(-1), x(0), y(0), width(0), height(0), radius(0), angle(0)
+        , vx(0), vy(0), frameCount(0), lostCount(0), checked(false)
+        , touchX(0), touchY(0), touched(false), touchCount(0)
+    {
+    }
+
+    static unsigned int GetId()
+    {
+        return currentId++;
+    }
+
+private:
+    static int currentId;
+};
+
+
+class LandoltTrackerEngine : public Stage
+{
+public:
+    struct Params
+    {
+        int contrastThreshold;
+        int touchContrastThreshold;
+        double templateThreshold;
+        int touchThreshold;
+        bool isOutputImage;
+        std::vector<double> templateScales;   // テンプレートの倍率（高さの違うランドルト環用）
+        int maxItems;
+        TemplateMatcher::Method matchMethod;   // Auto ならサイズから選ぶ
+        double trackingDistance;   // 予測位置からこの距離以内なら同じアイテムとみなす
+        int lostFrames;            // 見失ってから削除するまでのフレーム数
+
+        Params()
+            : contrastThreshold(100), touchContrastThreshold(100)
+            , templateThreshold(0.2), touchThreshold(0), isOutputImage(true)
+            , templateScales(1, 1.0), maxItems(64), matchMethod(TemplateMatcher::Auto)
+            , trackingDistance(50.0), lostFrames(10)
+        {
+        }
+    };
+
+    LandoltTrackerEngine();
+
+    void setParams(const Params& params);
+    Params params() const;
+    void setTemplateImage(const cv::Mat& image);
+    cv::Mat templateImage() const;
+    std::vector<TrackedItem> items() const;
+    // 直前のフレームで倍率ごとに使ったマッチング方法（カンマ区切り）
+    std::string matchMethod() const;
+
+    std::string name() const override;
+    void process(const cv::Mat& input, cv::Mat& output) override;
+
+private:
+    // ROI の中心から放射状に飛ばすレイのサンプル位置の表（テンプレートの大きさごとに作る）
+    // レイ i のサンプルは [rayBegin[i], rayBegin[i + 1]) に中心から近い順に並ぶ
+    struct PolarTable
+    {
+        std::vector<int> rayBegin;
+        std::vector<int> offsets;         // ROI 先頭からの画素オフセット（y * 幅 + x）
+        std::vector<int> radiuses;
+        std::vector<cv::Point> points;    // 描画用（ROI 内の座標）
+        std::vector<double> cosTable, sinTable;
+    };
+
+    // テンプレートマッチングで見つかった 1 つの候補の解析結果
+    struct LandoltCandidate
+    {
+        cv::Point position;   // 左上
+        cv::Point size;
+        double scale;         // テンプレートの大きさ (px)
+        double score;
+        const PolarTable* polarTable;
+        int holeCount;        // 抜けたレイの数
+        double holeAngle;     // 抜けたレイの角度の円周平均
+        double radius;        // 当たったレイの平均半径（当たらなければ -1）
+        std::vector<cv::Point> rayPoints;   // 描画用（ROI 内の座標）
+    };
+
+    // 倍率ごとに縮小してグレースケールにしたテンプレート
+    struct ScaledTemplate
+    {
+        double scale;
+        cv::Point size;       // 入力画像上での大きさ
+        double templateScale;
+        TemplateMatcher matcher;
+        std::shared_ptr<const PolarTable> polarTable;
+    };
+
+    static std::shared_ptr<const PolarTable> createPolarTable(const cv::Point& size, double templateScale);
+
+    void preProcess(cv::Mat& image);
+    void updateTemplateCache();
+    void detectLandolt(cv::Mat& outputImage, cv::Mat& inputImage);
+    void analyzeLandolt(LandoltCandidate& candidate, const cv::Mat& inputImage) const;
+    void detectLandoltTouch(cv::Mat& outputImage, cv::Mat& inputImage);
+    void detectTouch(TrackedItem& item, const cv::Mat& inputImage) const;
+    void updateItems(const std::vector<TrackedItem>& currentItems);
+
+    mutable std::mutex mutex_;
+    Params params_;
+    cv::Mat templateImage_;
+
+    // 処理スレッドだけが触る作業用の状態と、外から読む用のコピー
+    Params currentParams_;
+    cv::Mat currentTemplateImage_;
+    std::vector<TrackedItem> items_;
+    cv::Mat touchIntegral_;
+    std::vector<ScaledTemplate> scaledTemplates_;
+    cv::Mat cachedTemplateImage_;
+    std::vector<double> cachedTemplateScales_;
+    std::map<std::pair<int, int>, std::shared_ptr<const PolarTable>> polarTables_;
+    std::string matchMethod_;
+    std::vector<TrackedItem> publishedItems_;
+    std::string publishedMatchMethod_;
+};
+
+
+}
+
+#endif // LANDOLT_TRACKER_ENGINE_H
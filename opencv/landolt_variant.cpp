@@ -0,0 +1,31 @@
+﻿#include "landolt_variant.h"
+#include "mat_metatype.h"
+
+using namespace Littai;
+
+
+
+QVariantMap Littai::toVariantMap(const TrackedItem& item, int width, int height)
+{
+    // 見失っている間は最後の速度で進めた予測位置を出す
+    const auto x = item.x + item.vx * item.lostCount;
+    const auto y = item.y + item.vy * item.lostCount;
+
+    QVariantMap o;
+    o.insert("id",         item.id);
+    o.insert("x",          2.0 * x / width - 1.0);
+    o.insert("y",          1.0 - 2.0 * y / height);
+    o.insert("width",      item.width / width);
+    o.insert("height",     item.height / height);
+    o.insert("radius",     item.radius / ((width + height) / 2));
+    o.insert("angle",      item.angle);
+    o.insert("frameCount", item.frameCount);
+    o.insert("lostCount",  item.lostCount);
+    o.insert("image",      QVariant::fromValue(item.image));
+    o.insert("touchImage", QVariant::fromValue(item.touchImage));
+    o.insert("touched",    item.touched);
+    o.insert("touchX",     item.touchX);
+    o.insert("touchY",     item.touchY);
+    o.insert("touchCount", item.touchCount);
+    return o;
+}
@@ -0,0 +1,18 @@
+﻿#ifndef LANDOLT_VARIANT_H
+#define LANDOLT_VARIANT_H
+
+#include <QVariantMap>
+#include "landolt_tracker_engine.h"
+
+
+namespace Littai
+{
+
+
+// QML / OSC に渡す形式に変換する（座標は -1 〜 1 に正規化）
+QVariantMap toVariantMap(const TrackedItem& item, int width, int height);
+
+
+}
+
+#endif // LANDOLT_VARIANT_H
@@ -0,0 +1,9 @@
+﻿#ifndef MAT_METATYPE_H
+#define MAT_METATYPE_H
+
+#include <QMetaType>
+#include <opencv2/opencv.hpp>
+
+Q_DECLARE_METATYPE(cv::Mat)
+
+#endif // MAT_METATYPE_H
@@ -1,4 +1,4 @@
-INCLUDEPATH += $$PWD
+include($$PWD/opencv_core.pri)
 
 SOURCES += \
     $$PWD/image.cpp \
@@ -7,6 +7,8 @@ SOURCES += \
     $$PWD/diff_image.cpp \
     $$PWD/landolt_tracker.cpp \
     $$PWD/reverse_image.cpp \
+    $$PWD/recorder.cpp \
+    $$PWD/replay.cpp \
 
 HEADERS += \
     $$PWD/image.h \
@@ -15,39 +17,5 @@ HEADERS += \
     $$PWD/diff_image.h \
     $$PWD/landolt_tracker.h \
     $$PWD/reverse_image.h \
-
-win32 {
-
-    QMAKE_INCDIR += \
-        $$(OpenCV_DIR)/include
-
-    QMAKE_LIBDIR += \
-        $$(OpenCV_DIR)/x86/vc12/lib
-
-    QMAKE_CXXFLAGS += -fopenmp
-
-    QMAKE_LIBS += -fopenmp
-
-    CONFIG(debug, debug|release) {
-        QMAKE_LIBS += \
-            -lopencv_core2411d -lopencv_highgui2411d -lopencv_imgproc2411d -lopencv_calib3d2411d -lopencv_video2411d
-    }
-
-    CONFIG(release, debug|release) {
-        QMAKE_LIBS += \
-            -lopencv_core2411 -lopencv_highgui2411 -lopencv_imgproc2411 -lopencv_calib3d2411 -lopencv_video2411
-    }
-
-}
-
-macx {
-
-	QMAKE_INCDIR += \
-		/usr/local/include
-
-	QMAKE_LIBDIR += \
-		/usr/local/lib
-
-	QMAKE_LIBS += \
-		-lopencv_core -lopencv_highgui -lopencv_imgproc -lopencv_calib3d
-}
+    $$PWD/recorder.h \
+    $$PWD/replay.h \
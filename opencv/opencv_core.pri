@@ -0,0 +1,73 @@
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/homography_engine.cpp \
+    $$PWD/diff_image_engine.cpp \
+    $$PWD/landolt_tracker_engine.cpp \
+    $$PWD/template_matcher.cpp \
+    $$PWD/frame_averager.cpp \
+    $$PWD/landolt_variant.cpp \
+    $$PWD/frame_file.cpp \
+    $$PWD/frame_source.cpp \
+    $$PWD/stage_worker.cpp \
+    $$PWD/work_stealing_pool.cpp \
+    $$PWD/assignment.cpp \
+
+HEADERS += \
+    $$PWD/stage.h \
+    $$PWD/mat_metatype.h \
+    $$PWD/vector_math.h \
+    $$PWD/homography_engine.h \
+    $$PWD/diff_image_engine.h \
+    $$PWD/landolt_tracker_engine.h \
+    $$PWD/template_matcher.h \
+    $$PWD/frame_averager.h \
+    $$PWD/landolt_variant.h \
+    $$PWD/frame_file.h \
+    $$PWD/frame_source.h \
+    $$PWD/stage_worker.h \
+    $$PWD/work_stealing_pool.h \
+    $$PWD/assignment.h \
+
+win32 {
+
+    QMAKE_INCDIR += \
+        $$(OpenCV_DIR)/include
+
+    QMAKE_LIBDIR += \
+        $$(OpenCV_DIR)/x86/vc12/lib
+
+    QMAKE_CXXFLAGS += -fopenmp
+
+    QMAKE_LIBS += -fopenmp
+
+    CONFIG(debug, debug|release) {
+        QMAKE_LIBS += \
+            -lopencv_core2411d -lopencv_highgui2411d -lopencv_imgproc2411d -lopencv_calib3d2411d -lopencv_video2411d
+    }
+
+    CONFIG(release, debug|release) {
+        QMAKE_LIBS += \
+            -lopencv_core2411 -lopencv_highgui2411 -lopencv_imgproc2411 -lopencv_calib3d2411 -lopencv_video2411
+    }
+
+}
+
+macx {
+
+	QMAKE_INCDIR += \
+		/usr/local/include
+
+	QMAKE_LIBDIR += \
+		/usr/local/lib
+
+	QMAKE_LIBS += \
+		-lopencv_core -lopencv_highgui -lopencv_imgproc -lopencv_calib3d
+}
+
+unix:!macx {
+
+    CONFIG += link_pkgconfig
+
+    PKGCONFIG += opencv
+}
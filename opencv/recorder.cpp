@@ -0,0 +1,144 @@
+﻿#include "recorder.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    // 書き込みが追いつかない場合に溜めておく最大フレーム数
+    const std::size_t maxQueueSize = 120;
+}
+
+
+
+Recorder::Recorder(QQuickItem *parent)
+    : Image(parent)
+    , isGray_(true)
+    , isRecording_(false)
+    , frameCount_(0)
+    , droppedCount_(0)
+{
+}
+
+
+Recorder::~Recorder()
+{
+    stop();
+}
+
+
+void Recorder::setInputImage(const QVariant &image)
+{
+    const auto timestamp = std::chrono::steady_clock::now();
+    image.value<cv::Mat>().copyTo(inputImage_);
+    emit inputImageChanged();
+
+    if (!isRecording_ || inputImage_.empty()) return;
+
+    Frame frame;
+    frame.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(timestamp - startTime_).count();
+
+    // IR 画像は BGR に展開されているので 1 チャンネルに戻して保存する
+    if (isGray_ && inputImage_.channels() == 3) {
+        cv::cvtColor(inputImage_, frame.image, cv::COLOR_BGR2GRAY);
+    } else {
+        frame.image = inputImage_.clone();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frames_.size() >= maxQueueSize) {
+            ++droppedCount_;
+            return;
+        }
+        frames_.push_back(frame);
+    }
+    condition_.notify_one();
+
+    emit frameCountChanged();
+}
+
+
+QVariant Recorder::inputImage() const
+{
+    return QVariant::fromValue(inputImage_);
+}
+
+
+bool Recorder::isRecording() const
+{
+    return isRecording_;
+}
+
+
+int Recorder::frameCount() const
+{
+    return frameCount_;
+}
+
+
+void Recorder::start()
+{
+    if (isRecording_) return;
+
+    if (!writer_.open(recordPath_.toStdString())) {
+        error("failed to open " + recordPath_);
+        return;
+    }
+
+    frameCount_   = 0;
+    droppedCount_ = 0;
+    startTime_    = std::chrono::steady_clock::now();
+    isRecording_  = true;
+
+    thread_ = std::thread(&Recorder::write, this);
+
+    emit isRecordingChanged();
+    emit frameCountChanged();
+}
+
+
+void Recorder::stop()
+{
+    if (!isRecording_) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRecording_ = false;
+    }
+    condition_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    writer_.close();
+
+    if (droppedCount_ > 0) {
+        qDebug() << droppedCount_ << "frames were dropped while recording.";
+    }
+
+    emit isRecordingChanged();
+    emit frameCountChanged();
+}
+
+
+void Recorder::write()
+{
+    // 停止要求後もキューに残っているフレームは書き切る
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return !frames_.empty() || !isRecording_; });
+            if (frames_.empty()) break;
+            frame = frames_.front();
+            frames_.pop_front();
+        }
+
+        if (!writer_.write(frame.image, frame.timestamp)) {
+            qDebug() << "failed to write frame to" << recordPath_;
+            continue;
+        }
+        frameCount_ = writer_.frameCount();
+    }
+}
@@ -0,0 +1,72 @@
+﻿#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "image.h"
+#include "frame_file.h"
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <condition_variable>
+#include <chrono>
+
+
+namespace Littai
+{
+
+
+class Recorder : public Image
+{
+    Q_OBJECT
+    Q_PROPERTY(QVariant inputImage WRITE setInputImage READ inputImage NOTIFY inputImageChanged)
+    Q_PROPERTY(QString recordPath MEMBER recordPath_ NOTIFY recordPathChanged)
+    Q_PROPERTY(bool isGray MEMBER isGray_ NOTIFY isGrayChanged)
+    Q_PROPERTY(bool isRecording READ isRecording NOTIFY isRecordingChanged)
+    Q_PROPERTY(int frameCount READ frameCount NOTIFY frameCountChanged)
+
+public:
+    explicit Recorder(QQuickItem *parent = nullptr);
+    ~Recorder();
+
+    void setInputImage(const QVariant& image);
+    QVariant inputImage() const;
+    bool isRecording() const;
+    int frameCount() const;
+
+    Q_INVOKABLE void start();
+    Q_INVOKABLE void stop();
+
+private:
+    struct Frame
+    {
+        cv::Mat image;
+        std::int64_t timestamp;
+    };
+
+    void write();
+
+    FrameWriter writer_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Frame> frames_;
+    std::chrono::steady_clock::time_point startTime_;
+
+    cv::Mat inputImage_;
+    QString recordPath_;
+    bool isGray_;
+    bool isRecording_;
+    std::atomic<int> frameCount_;   // 書き込みスレッドが更新し、GUI スレッドが読む
+    int droppedCount_;
+
+signals:
+    void inputImageChanged() const;
+    void recordPathChanged() const;
+    void isGrayChanged() const;
+    void isRecordingChanged() const;
+    void frameCountChanged() const;
+};
+
+
+}
+
+#endif // RECORDER_H
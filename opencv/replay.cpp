@@ -0,0 +1,173 @@
+﻿#include <chrono>
+#include "replay.h"
+
+using namespace Littai;
+
+
+
+Replay::Replay(QQuickItem *parent)
+    : Image(parent)
+    , isFrameConsumed_(true)
+    , isPlaying_(false)
+    , isRealTime_(true)
+    , isLoop_(false)
+    , frameIndex_(0)
+{
+    // 読み出しスレッドからのフレームは GUI スレッドで受け取る
+    connect(this, SIGNAL(frameArrived()), this, SLOT(fetch()), Qt::QueuedConnection);
+    // 再生スレッドが終わると finished が GUI スレッドで呼ばれる
+    connect(this, SIGNAL(finished()), this, SIGNAL(isPlayingChanged()));
+}
+
+
+Replay::~Replay()
+{
+    stop();
+}
+
+
+QString Replay::recordPath() const
+{
+    return recordPath_;
+}
+
+
+void Replay::setRecordPath(const QString& path)
+{
+    if (recordPath_ == path) return;
+
+    stop();
+    {
+        // マップ領域を参照したままのフレームを手放してから開き直す
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame_.release();
+        isFrameConsumed_ = true;
+    }
+    recordPath_ = path;
+    if (!reader_.open(path.toStdString())) {
+        error(path + " is not a valid record file");
+    }
+
+    emit recordPathChanged();
+    emit frameCountChanged();
+}
+
+
+int Replay::frameCount() const
+{
+    return reader_.frameCount();
+}
+
+
+int Replay::frameIndex() const
+{
+    return frameIndex_;
+}
+
+
+bool Replay::isPlaying() const
+{
+    return isPlaying_;
+}
+
+
+void Replay::start()
+{
+    if (isPlaying_ || !reader_.isOpened()) return;
+
+    // 最後まで再生し終えたスレッドが残っていれば回収しておく
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    reader_.rewind();
+    frameIndex_      = 0;
+    isFrameConsumed_ = true;
+    isPlaying_       = true;
+    thread_ = std::thread(&Replay::play, this);
+
+    emit isPlayingChanged();
+}
+
+
+void Replay::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isPlaying_ = false;
+    }
+    condition_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+
+void Replay::play()
+{
+    using namespace std::chrono;
+
+    cv::Mat frame;
+    std::int64_t timestamp = 0, firstTimestamp = 0;
+    auto startTime = steady_clock::now();
+    bool isFirst = true;
+
+    while (isPlaying_) {
+        if (!reader_.read(frame, timestamp)) {
+            if (!isLoop_) break;
+            reader_.rewind();
+            isFirst = true;
+            continue;
+        }
+
+        // 録画時のタイムスタンプに合わせて待つ（stop() で起こされたらすぐ抜ける）
+        if (isFirst) {
+            firstTimestamp = timestamp;
+            startTime = steady_clock::now();
+            isFirst = false;
+        } else if (isRealTime_) {
+            const auto target = startTime + microseconds(timestamp - firstTimestamp);
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_until(lock, target, [this] { return !isPlaying_; });
+            if (!isPlaying_) break;
+        }
+
+        // 前のフレームが取り出されるまで待つことで、
+        // 再生速度によらず全フレームを同じ順序で流す
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return isFrameConsumed_ || !isPlaying_; });
+            if (!isPlaying_) break;
+            // マップされた領域をそのまま参照する（コピーしない）
+            frame_ = frame;
+            isFrameConsumed_ = false;
+        }
+
+        emit frameArrived();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isPlaying_ = false;
+    }
+    QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+}
+
+
+void Replay::fetch()
+{
+    cv::Mat image;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (isFrameConsumed_) return;
+
+        // 1 チャンネルで保存されたものは後段に合わせて BGR に戻す
+        convertToBgr(frame_, image);
+        isFrameConsumed_ = true;
+        ++frameIndex_;
+    }
+
+    setImage(image);
+    condition_.notify_one();
+    emit frameIndexChanged();
+}
@@ -0,0 +1,72 @@
+﻿#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "image.h"
+#include "frame_file.h"
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+
+namespace Littai
+{
+
+
+class Replay : public Image
+{
+    Q_OBJECT
+    Q_PROPERTY(QString recordPath READ recordPath WRITE setRecordPath NOTIFY recordPathChanged)
+    Q_PROPERTY(bool isRealTime MEMBER isRealTime_ NOTIFY isRealTimeChanged)
+    Q_PROPERTY(bool isLoop MEMBER isLoop_ NOTIFY isLoopChanged)
+    Q_PROPERTY(int frameCount READ frameCount NOTIFY frameCountChanged)
+    Q_PROPERTY(int frameIndex READ frameIndex NOTIFY frameIndexChanged)
+    Q_PROPERTY(bool isPlaying READ isPlaying NOTIFY isPlayingChanged)
+
+public:
+    explicit Replay(QQuickItem *parent = nullptr);
+    ~Replay();
+
+    QString recordPath() const;
+    void setRecordPath(const QString& path);
+    int frameCount() const;
+    int frameIndex() const;
+
+    Q_INVOKABLE void start();
+    Q_INVOKABLE void stop();
+    bool isPlaying() const;
+
+private:
+    void play();
+
+    FrameReader reader_;
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+
+    cv::Mat frame_;
+    bool isFrameConsumed_;
+    std::atomic<bool> isPlaying_;   // 書き換えは mutex_ の中で（待っている再生スレッドを起こすため）
+
+    QString recordPath_;
+    bool isRealTime_;
+    bool isLoop_;
+    int frameIndex_;
+
+private slots:
+    void fetch();
+
+signals:
+    void recordPathChanged() const;
+    void isRealTimeChanged() const;
+    void isLoopChanged() const;
+    void frameCountChanged() const;
+    void frameIndexChanged() const;
+    void isPlayingChanged() const;
+    void frameArrived() const;
+    void finished() const;
+};
+
+
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,25 @@
+﻿#ifndef STAGE_H
+#define STAGE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+
+namespace Littai
+{
+
+
+// 認識パイプラインの 1 段（Qt に依存しない処理本体）
+// 入力 (BGR) を処理して出力 (BGR) を返す
+class Stage
+{
+public:
+    virtual ~Stage() {}
+    virtual std::string name() const = 0;
+    virtual void process(const cv::Mat& input, cv::Mat& output) = 0;
+};
+
+
+}
+
+#endif // STAGE_H
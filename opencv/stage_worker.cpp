@@ -0,0 +1,109 @@
+﻿#include "stage_worker.h"
+
+using namespace Littai;
+
+
+
+StageWorker::StageWorker(Stage& stage)
+    : stage_(stage)
+    , isRunning_(false)
+    , isInputUpdated_(false)
+    , fps_(30)
+{
+}
+
+
+StageWorker::~StageWorker()
+{
+    stop();
+}
+
+
+void StageWorker::setFps(int fps)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    fps_ = fps;
+}
+
+
+void StageWorker::setCallback(const Callback& callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+}
+
+
+void StageWorker::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isRunning_) return;
+    isRunning_ = true;
+    thread_ = std::thread(&StageWorker::run, this);
+}
+
+
+void StageWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRunning_ = false;
+    }
+    condition_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+
+bool StageWorker::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isRunning_;
+}
+
+
+void StageWorker::push(const cv::Mat& input)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        input_ = input;
+        isInputUpdated_ = true;
+    }
+    condition_.notify_all();
+}
+
+
+void StageWorker::run()
+{
+    using namespace std::chrono;
+
+    for (;;) {
+        cv::Mat input, output;
+        Callback callback;
+        int fps;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [&] { return !isRunning_ || isInputUpdated_; });
+            if (!isRunning_) break;
+            input = input_;
+            isInputUpdated_ = false;
+            callback = callback_;
+            fps = fps_;
+        }
+
+        const auto t1 = high_resolution_clock::now();
+        stage_.process(input, output);
+        if (!output.empty() && callback) {
+            callback(output);
+        }
+        const auto t2 = high_resolution_clock::now();
+
+        // fps を上限に処理する（停止要求が来たらすぐ抜ける）
+        if (fps <= 0) continue;
+        const auto waitTime = microseconds(1000000 / fps) - duration_cast<microseconds>(t2 - t1);
+        if (waitTime > microseconds::zero()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, waitTime, [&] { return !isRunning_; });
+        }
+    }
+}
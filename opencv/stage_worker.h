@@ -0,0 +1,53 @@
+﻿#ifndef STAGE_WORKER_H
+#define STAGE_WORKER_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "stage.h"
+
+
+namespace Littai
+{
+
+
+// Stage を専用スレッドで回すワーカ（Qt に依存しない）
+// 入力は最新の 1 枚だけを保持し、処理が追いつかない分は捨てる
+class StageWorker
+{
+public:
+    typedef std::function<void(const cv::Mat& output)> Callback;
+
+    explicit StageWorker(Stage& stage);
+    ~StageWorker();
+
+    void setFps(int fps);
+    void setCallback(const Callback& callback);
+
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    // input は処理スレッドと共有されるので、呼び出し側は書き換えないこと
+    void push(const cv::Mat& input);
+
+private:
+    void run();
+
+    Stage& stage_;
+    Callback callback_;
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    bool isRunning_;
+    bool isInputUpdated_;
+    cv::Mat input_;
+    int fps_;
+};
+
+
+}
+
+#endif // STAGE_WORKER_H
@@ -0,0 +1,143 @@
+﻿#include <cmath>
+#include <algorithm>
+#include "template_matcher.h"
+
+using namespace Littai;
+
+
+
+TemplateMatcher::TemplateMatcher()
+    : templateNorm_(0)
+{
+}
+
+
+void TemplateMatcher::setTemplate(const cv::Mat& grayTemplate)
+{
+    template_ = grayTemplate;
+
+    const auto mean = cv::mean(template_)[0];
+    const auto sqNorm = cv::norm(template_, cv::NORM_L2SQR);
+    templateNorm_ = std::sqrt(std::max(sqNorm - mean * mean * template_.total(), 0.0));
+
+    // スペクトルは次の match で入力サイズに合わせて作る
+    dftSize_ = cv::Size();
+    templateSpectrum_.release();
+}
+
+
+const cv::Mat& TemplateMatcher::templateImage() const
+{
+    return template_;
+}
+
+
+TemplateMatcher::Method TemplateMatcher::match(const cv::Mat& grayImage, cv::Mat& result, Method method)
+{
+    if (method == Auto) {
+        method = choose(grayImage.size(), template_.size());
+    }
+
+    if (method == Fft) {
+        matchFft(grayImage, result);
+    } else {
+        cv::matchTemplate(grayImage, template_, result, cv::TM_CCOEFF_NORMED);
+    }
+
+    return method;
+}
+
+
+TemplateMatcher::Method TemplateMatcher::choose(const cv::Size& imageSize, const cv::Size& templateSize)
+{
+    // 空間領域：結果の画素数 x テンプレートの画素数
+    const double resultArea = static_cast<double>(imageSize.width - templateSize.width + 1) * (imageSize.height - templateSize.height + 1);
+    const double spatialCost = resultArea * templateSize.area();
+
+    // 周波数領域：順変換と逆変換の 2 回分（テンプレート側はキャッシュ済み）
+    const double dftArea = static_cast<double>(cv::getOptimalDFTSize(imageSize.width)) * cv::getOptimalDFTSize(imageSize.height);
+    const double fftCost = 2 * 4 * dftArea * std::log(dftArea) / std::log(2.0);
+
+    return (spatialCost > fftCost) ? Fft : Spatial;
+}
+
+
+const char* TemplateMatcher::methodName(Method method)
+{
+    switch (method) {
+        case Spatial: return "spatial";
+        case Fft:     return "fft";
+        default:      return "auto";
+    }
+}
+
+
+TemplateMatcher::Method TemplateMatcher::methodFromName(const std::string& name)
+{
+    if (name == "spatial") return Spatial;
+    if (name == "fft")     return Fft;
+    return Auto;
+}
+
+
+void TemplateMatcher::updateSpectrum(const cv::Size& dftSize)
+{
+    dftSize_ = dftSize;
+
+    // 平均を引いておけば、分子は入力側の平均を引かなくても同じになる
+    cv::Mat padded = cv::Mat::zeros(dftSize_, CV_32F);
+    cv::Mat roi = padded(cv::Rect(0, 0, template_.cols, template_.rows));
+    template_.convertTo(roi, CV_32F);
+    roi -= cv::mean(template_)[0];
+    cv::dft(padded, templateSpectrum_, 0, template_.rows);
+
+    // 入力の余白は相関の有効範囲に影響しないが、初期化だけしておく
+    paddedImage_ = cv::Mat::zeros(dftSize_, CV_32F);
+}
+
+
+void TemplateMatcher::matchFft(const cv::Mat& grayImage, cv::Mat& result)
+{
+    const int w = template_.cols;
+    const int h = template_.rows;
+    const cv::Size resultSize(grayImage.cols - w + 1, grayImage.rows - h + 1);
+
+    // 有効範囲は循環しないので、入力サイズ分あれば足りる
+    const cv::Size dftSize(cv::getOptimalDFTSize(grayImage.cols), cv::getOptimalDFTSize(grayImage.rows));
+    if (dftSize != dftSize_ || templateSpectrum_.empty()) {
+        updateSpectrum(dftSize);
+    }
+
+    // 分子：平均を引いたテンプレートとの相関
+    cv::Mat roi = paddedImage_(cv::Rect(0, 0, grayImage.cols, grayImage.rows));
+    grayImage.convertTo(roi, CV_32F);
+    cv::dft(paddedImage_, imageSpectrum_, 0, grayImage.rows);
+    cv::mulSpectrums(imageSpectrum_, templateSpectrum_, productSpectrum_, 0, true);
+    cv::dft(productSpectrum_, correlation_, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, resultSize.height);
+
+    // 分母：積分画像から窓ごとの分散を求める
+    cv::integral(grayImage, sum_, sqsum_, CV_64F);
+
+    result.create(resultSize, CV_32F);
+    const double area = static_cast<double>(w) * h;
+    for (int y = 0; y < resultSize.height; ++y) {
+        const auto* s0  = sum_.ptr<double>(y);
+        const auto* s1  = sum_.ptr<double>(y + h);
+        const auto* q0  = sqsum_.ptr<double>(y);
+        const auto* q1  = sqsum_.ptr<double>(y + h);
+        const auto* num = correlation_.ptr<float>(y);
+        auto* out = result.ptr<float>(y);
+        for (int x = 0; x < resultSize.width; ++x) {
+            const double sum   = s1[x + w] - s1[x] - s0[x + w] + s0[x];
+            const double sqsum = q1[x + w] - q1[x] - q0[x + w] + q0[x];
+            const double variance = std::max(sqsum - sum * sum / area, 0.0);
+            const double denominator = templateNorm_ * std::sqrt(variance);
+            // 平坦な領域は 0 にする
+            if (denominator < 1e-3) {
+                out[x] = 0.0f;
+            } else {
+                out[x] = static_cast<float>(std::min(std::max(num[x] / denominator, -1.0), 1.0));
+            }
+        }
+    }
+}
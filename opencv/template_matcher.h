@@ -0,0 +1,57 @@
+﻿#ifndef TEMPLATE_MATCHER_H
+#define TEMPLATE_MATCHER_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+
+namespace Littai
+{
+
+
+// TM_CCOEFF_NORMED 相当のテンプレートマッチング（Qt に依存しない）
+// テンプレートが大きいときは周波数領域で相関を取る
+// テンプレートのスペクトルは入力サイズが変わるまで使い回し、DFT のバッファもフレーム間で再利用する
+class TemplateMatcher
+{
+public:
+    enum Method
+    {
+        Auto,
+        Spatial,
+        Fft
+    };
+
+    TemplateMatcher();
+
+    // 8bit グレースケールのテンプレート
+    void setTemplate(const cv::Mat& grayTemplate);
+    const cv::Mat& templateImage() const;
+
+    // result は (W - w + 1) x (H - h + 1) の CV_32F。実際に使った方法を返す
+    Method match(const cv::Mat& grayImage, cv::Mat& result, Method method = Auto);
+
+    // おおよその演算量から速いほうを選ぶ
+    static Method choose(const cv::Size& imageSize, const cv::Size& templateSize);
+    static const char* methodName(Method method);
+    static Method methodFromName(const std::string& name);
+
+private:
+    void updateSpectrum(const cv::Size& dftSize);
+    void matchFft(const cv::Mat& grayImage, cv::Mat& result);
+
+    cv::Mat template_;
+    double templateNorm_;   // 平均を引いたテンプレートの L2 ノルム
+
+    cv::Size dftSize_;
+    cv::Mat templateSpectrum_;
+
+    // フレーム間で使い回すバッファ
+    cv::Mat paddedImage_, imageSpectrum_, productSpectrum_, correlation_;
+    cv::Mat sum_, sqsum_;
+};
+
+
+}
+
+#endif // TEMPLATE_MATCHER_H
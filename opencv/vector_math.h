@@ -0,0 +1,56 @@
+﻿#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <cmath>
+
+
+namespace Littai
+{
+
+
+template <class T>
+inline auto len(const T& v) -> decltype(v.x)
+{
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+template <class T, class U>
+inline auto dot(const T& v1, const U& v2) -> decltype(v1.x * v2.x)
+{
+    return v1.x * v2.x + v1.y * v2.y;
+}
+
+template <class T>
+inline T normalize(const T& v)
+{
+    return v * (1.0 / len(v));
+}
+
+template <class T>
+inline T toUnit(const T& v, const double scaleX, const double scaleY)
+{
+    return T(2.0 * v.x / scaleX - 1.0, 1.0 - 2.0 * v.y / scaleY);
+}
+
+template <class T>
+inline int sign(const T& v)
+{
+    return v >= 0 ? 1 : -1;
+}
+
+template <class T>
+inline T rotate(const T& pos, double angle)
+{
+    return T(pos.x * cos(angle) - pos.y * sin(angle), pos.x * sin(angle) + pos.y * cos(angle));
+}
+
+template <class T>
+inline T toLocal(const T& pos, const T& parentPos, double parentAngle)
+{
+    return rotate(T(pos.x - parentPos.x, pos.y - parentPos.y), -parentAngle);
+}
+
+
+}
+
+#endif // VECTOR_MATH_H
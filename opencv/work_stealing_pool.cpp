@@ -0,0 +1,171 @@
+﻿#include <algorithm>
+#include "work_stealing_pool.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    std::once_flag sharedPoolFlag;
+    WorkStealingPool* sharedPool = nullptr;
+}
+
+
+
+WorkStealingPool::WorkStealingPool(int threadCount)
+    : pendingCount_(0)
+    , isRunning_(true)
+    , nextQueue_(0)
+{
+    threadCount = std::max(threadCount, 1);
+    for (int i = 0; i < threadCount; ++i) {
+        queues_.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        threads_.push_back(std::thread(&WorkStealingPool::run, this, i));
+    }
+}
+
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRunning_ = false;
+    }
+    condition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+
+WorkStealingPool& WorkStealingPool::shared()
+{
+    // 終了時の破棄順の問題を避けるため解放しない
+    std::call_once(sharedPoolFlag, [] {
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        sharedPool = new WorkStealingPool(std::max(cores - 1, 1));
+    });
+    return *sharedPool;
+}
+
+
+int WorkStealingPool::threadCount() const
+{
+    return static_cast<int>(threads_.size());
+}
+
+
+void WorkStealingPool::parallelFor(int count, const Body& body)
+{
+    if (count <= 0) return;
+    if (count == 1) {
+        body(0);
+        return;
+    }
+
+    Batch batch;
+    batch.body      = &body;
+    batch.remaining = count;
+
+    // 各ワーカのキューに順番に配る
+    const auto n = static_cast<unsigned int>(queues_.size());
+    for (int i = 0; i < count; ++i) {
+        auto& queue = *queues_[nextQueue_++ % n];
+        std::lock_guard<std::mutex> queueLock(queue.mutex);
+        queue.tasks.push_back(Task{ &batch, i });
+    }
+    pendingCount_ += count;
+
+    // 待ちに入る直前のワーカが通知を取りこぼさないよう、mutex_ を取ってから起こす
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    condition_.notify_all();
+
+    // 待っている間は呼び出し元も手伝う
+    Task task;
+    while (pop(-1, task)) {
+        execute(task);
+    }
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.condition.wait(lock, [&] { return batch.remaining == 0; });
+    if (batch.exception) {
+        std::rethrow_exception(batch.exception);
+    }
+}
+
+
+void WorkStealingPool::run(int id)
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [&] { return !isRunning_ || pendingCount_ > 0; });
+            if (!isRunning_) break;
+        }
+
+        Task task;
+        while (pop(id, task)) {
+            execute(task);
+        }
+    }
+}
+
+
+bool WorkStealingPool::pop(int id, Task& task)
+{
+    const int n = static_cast<int>(queues_.size());
+
+    // 自分のキューの先頭から
+    if (id >= 0) {
+        auto& queue = *queues_[id];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            --pendingCount_;
+            return true;
+        }
+    }
+
+    // 他のキューの末尾から盗む
+    const int start = (id >= 0) ? id + 1 : 0;
+    for (int i = 0; i < n; ++i) {
+        auto& queue = *queues_[(start + i) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            --pendingCount_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void WorkStealingPool::execute(const Task& task)
+{
+    auto& batch = *task.batch;
+
+    std::exception_ptr exception;
+    try {
+        (*batch.body)(task.index);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+
+    // batch は呼び出し元のスタックにあるので、ロックを外した後は触らない
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    if (exception && !batch.exception) {
+        batch.exception = exception;
+    }
+    if (--batch.remaining == 0) {
+        batch.condition.notify_all();
+    }
+}
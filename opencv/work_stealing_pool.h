@@ -0,0 +1,78 @@
+﻿#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+
+namespace Littai
+{
+
+
+// ワークスティーリング方式のスレッドプール（Qt に依存しない）
+// 各ワーカは自分のキューの先頭から取り、空なら他のワーカのキューの末尾から盗む
+// parallelFor を呼んだスレッドも終わるまでタスクを手伝うので、タスクの中から呼んでも詰まらない
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(int index)> Body;
+
+    explicit WorkStealingPool(int threadCount);
+    ~WorkStealingPool();
+
+    // プロセス全体で共有するプール（コア数 - 1 個のワーカ）
+    static WorkStealingPool& shared();
+
+    int threadCount() const;
+
+    // body(0) 〜 body(count - 1) を並列に呼び、すべて終わるまで待つ
+    // タスクが投げた例外は最初の 1 つを呼び出し元に投げ直す
+    void parallelFor(int count, const Body& body);
+
+private:
+    struct Batch
+    {
+        const Body* body;
+        int remaining;
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    struct Task
+    {
+        Batch* batch;
+        int index;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int id);
+    bool pop(int id, Task& task);
+    void execute(const Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    // mutex_ は condition_ で眠る／起こすときだけ使い、キューのロックと同時には持たない
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::atomic<int> pendingCount_;
+    bool isRunning_;
+    std::atomic<unsigned int> nextQueue_;
+};
+
+
+}
+
+#endif // WORK_STEALING_POOL_H
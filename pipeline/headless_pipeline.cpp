@@ -0,0 +1,399 @@
+﻿#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QLocalSocket>
+#include <QDebug>
+#include <chrono>
+#include <algorithm>
+#include "headless_pipeline.h"
+#include "landolt_variant.h"
+#include "marker_variant.h"
+
+using namespace Littai;
+
+
+
+namespace
+{
+    std::shared_ptr<FrameSource> createSource(const QJsonObject& config)
+    {
+        const auto type = config["type"].toString("camera");
+        const auto path = config["path"].toString().toStdString();
+        if (type == "camera") {
+            return std::make_shared<CameraSource>(config["device"].toInt(0));
+        } else if (type == "replay") {
+            return std::make_shared<ReplaySource>(path);
+        } else if (type == "image") {
+            return std::make_shared<StillImageSource>(path);
+        }
+        return std::shared_ptr<FrameSource>();
+    }
+}
+
+
+
+// ---
+
+
+
+HeadlessPipeline::HeadlessPipeline(QObject* parent)
+    : QObject(parent)
+    , isBaseFromFirstFrame_(false)
+    , baseFrames_(1)
+    , isBaseMedian_(false)
+    , isLiveSource_(false)
+    , fps_(30)
+    , threadCount_(std::max(static_cast<int>(std::thread::hardware_concurrency()), 2))
+    , isRunning_(false)
+    , currentFps_(0.0)
+{
+    connect(&server_, SIGNAL(newConnection()), this, SLOT(sendStats()));
+}
+
+
+HeadlessPipeline::~HeadlessPipeline()
+{
+    stop();
+}
+
+
+bool HeadlessPipeline::load(const QString& configPath)
+{
+    QFile file(configPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << configPath << "cannot be opened.";
+        return false;
+    }
+
+    QJsonParseError error;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        qWarning() << configPath << ":" << error.errorString();
+        return false;
+    }
+    const auto config = document.object();
+
+    // 入力
+    const auto source = config["source"].toObject();
+    source_ = createSource(source);
+    if (!source_ || !source_->isValid()) {
+        qWarning() << "source is not available.";
+        return false;
+    }
+    isLiveSource_ = (source["type"].toString("camera") == "camera");
+    fps_ = config["fps"].toInt(30);
+
+    // スケジューラ
+    const auto pipeline = config["pipeline"].toObject();
+    threadCount_ = pipeline["threads"].toInt(threadCount_);
+    graph_.setMaxInFlight(pipeline["maxInFlight"].toInt(4));
+    graph_.setQueueCapacity(pipeline["queueCapacity"].toInt(2));
+    graph_.addNode(homography_.name(), homography_, "", nullptr);
+    graph_.addNode(diff_.name(), diff_, homography_.name(), nullptr);
+
+    // Homography
+    const auto homography = config["homography"].toObject();
+    const auto points = homography["points"].toArray();
+    if (points.size() == 8) {
+        std::vector<cv::Point2d> srcPoints;
+        for (int i = 0; i < 4; ++i) {
+            srcPoints.push_back(cv::Point2d(points[2 * i].toDouble(), points[2 * i + 1].toDouble()));
+        }
+        homography_.setSrcPoints(srcPoints);
+        const int size = homography["size"].toInt(480);
+        homography_.setOutputSize(size, size);
+    } else if (!points.isEmpty()) {
+        qWarning() << "homography.points needs 8 values.";
+        return false;
+    }
+
+    // DiffImage
+    const auto diff = config["diff"].toObject();
+    DiffImageEngine::Params diffParams;
+    diffParams.gamma                  = diff["gamma"].toDouble(diffParams.gamma);
+    diffParams.sharpness              = diff["sharpness"].toDouble(diffParams.sharpness);
+    diffParams.intensityCorrectionMin = diff["intensityCorrectionMin"].toDouble(diffParams.intensityCorrectionMin);
+    diffParams.intensityCorrectionMax = diff["intensityCorrectionMax"].toDouble(diffParams.intensityCorrectionMax);
+    diffParams.isAdaptiveBackground   = diff["adaptiveBackground"].toBool(diffParams.isAdaptiveBackground);
+    diffParams.backgroundRate         = diff["backgroundRate"].toDouble(diffParams.backgroundRate);
+    diffParams.foregroundSigma        = diff["foregroundSigma"].toDouble(diffParams.foregroundSigma);
+    diffParams.foregroundMinDiff      = diff["foregroundMinDiff"].toDouble(diffParams.foregroundMinDiff);
+    diff_.setParams(diffParams);
+
+    // 明るさの補正（フラットフィールドが無ければ縦の傾斜）
+    const auto flatFieldPath = diff["flatField"].toString();
+    if (!flatFieldPath.isEmpty()) {
+        const auto flatFieldImage = cv::imread(flatFieldPath.toStdString());
+        if (flatFieldImage.empty()) {
+            qWarning() << flatFieldPath << "is not found.";
+            return false;
+        }
+        diff_.setFlatFieldImage(flatFieldImage);
+    }
+
+    const auto basePath = diff["base"].toString("first");
+    isBaseFromFirstFrame_ = (basePath == "first");
+    baseFrames_   = diff["baseFrames"].toInt(baseFrames_);
+    isBaseMedian_ = diff["baseMedian"].toBool(isBaseMedian_);
+    if (!isBaseFromFirstFrame_) {
+        const auto baseImage = cv::imread(basePath.toStdString());
+        if (baseImage.empty()) {
+            qWarning() << basePath << "is not found.";
+            return false;
+        }
+        diff_.setBaseImage(baseImage);
+    }
+
+    // MarkerTracker
+    const auto marker = config["markerTracker"].toObject();
+    if (marker["enabled"].toBool(true)) {
+        MarkerTrackerEngine::Params params;
+        params.contrastThreshold     = marker["contrastThreshold"].toInt(params.contrastThreshold);
+        params.contrastThresholdMin  = marker["contrastThresholdMin"].toInt(params.contrastThresholdMin);
+        params.contrastThresholdMax  = marker["contrastThresholdMax"].toInt(params.contrastThresholdMax);
+        params.contrastThresholdStep = marker["contrastThresholdStep"].toInt(params.contrastThresholdStep);
+        params.predictionFrame       = marker["predictionFrame"].toInt(params.predictionFrame);
+        params.averageFrames         = marker["averageFrames"].toInt(params.averageFrames);
+        params.fps                   = fps_;
+        params.isOutputImage         = false;
+        markerTracker_ = std::make_shared<MarkerTrackerEngine>();
+        markerTracker_->setParams(params);
+        const auto patternPath = marker["patternFile"].toString();
+        if (!patternPath.isEmpty() && !markerTracker_->loadPatterns(patternPath.toStdString())) {
+            qWarning() << patternPath << "cannot be loaded as patterns.";
+            return false;
+        }
+        graph_.addNode(markerTracker_->name(), *markerTracker_, diff_.name(), [this](const cv::Mat& output) {
+            publishMarkers(output.cols, output.rows);
+        });
+    }
+
+    // LandoltTracker（テンプレートが無ければ動かさない）
+    const auto landolt = config["landoltTracker"].toObject();
+    const auto templatePath = landolt["template"].toString();
+    if (!templatePath.isEmpty()) {
+        const auto templateImage = cv::imread(templatePath.toStdString());
+        if (templateImage.empty()) {
+            qWarning() << templatePath << "is not found.";
+            return false;
+        }
+        LandoltTrackerEngine::Params params;
+        params.contrastThreshold      = landolt["contrastThreshold"].toInt(params.contrastThreshold);
+        params.touchContrastThreshold = landolt["touchContrastThreshold"].toInt(params.touchContrastThreshold);
+        params.templateThreshold      = landolt["templateThreshold"].toDouble(params.templateThreshold);
+        params.touchThreshold         = landolt["touchThreshold"].toInt(params.touchThreshold);
+        params.maxItems               = landolt["maxItems"].toInt(params.maxItems);
+        params.matchMethod            = TemplateMatcher::methodFromName(landolt["matchMethod"].toString("auto").toStdString());
+        params.trackingDistance       = landolt["trackingDistance"].toDouble(params.trackingDistance);
+        params.lostFrames             = landolt["lostFrames"].toInt(params.lostFrames);
+        params.isOutputImage          = false;
+        if (landolt.contains("templateScales")) {
+            params.templateScales.clear();
+            for (const auto& scale : landolt["templateScales"].toArray()) {
+                params.templateScales.push_back(scale.toDouble());
+            }
+        }
+        landoltTracker_ = std::make_shared<LandoltTrackerEngine>();
+        landoltTracker_->setParams(params);
+        landoltTracker_->setTemplateImage(templateImage);
+        // 座標の正規化は LandoltTracker と同じ rows / cols の順
+        graph_.addNode(landoltTracker_->name(), *landoltTracker_, diff_.name(), [this](const cv::Mat& output) {
+            publishLandolts(output.rows, output.cols);
+        });
+    }
+
+    // OSC
+    const auto osc = config["osc"].toObject();
+    osc_.setProperty("ip",   osc["ip"].toString("127.0.0.1"));
+    osc_.setProperty("port", osc["port"].toInt(4567));
+
+    // 統計
+    serverName_ = config["stats"].toObject()["server"].toString("littai");
+
+    return true;
+}
+
+
+void HeadlessPipeline::start()
+{
+    if (isRunning_ || !source_) return;
+
+    QLocalServer::removeServer(serverName_);
+    if (!server_.listen(serverName_)) {
+        qWarning() << "stats server" << serverName_ << ":" << server_.errorString();
+    }
+
+    isRunning_ = true;
+    graph_.start(threadCount_);
+    thread_ = std::thread(&HeadlessPipeline::run, this);
+}
+
+
+void HeadlessPipeline::stop()
+{
+    isRunning_ = false;
+    graph_.stop();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    server_.close();
+}
+
+
+void HeadlessPipeline::run()
+{
+    using namespace std::chrono;
+
+    auto fpsStart = high_resolution_clock::now();
+    int fpsCompleted = 0;
+
+    while (isRunning_) {
+        const auto t1 = high_resolution_clock::now();
+
+        // グラフの中のフレームと共有されるので毎回新しいバッファに読む
+        cv::Mat frame;
+        if (source_->next(frame)) {
+            if (isBaseFromFirstFrame_) {
+                cv::Mat baseImage;
+                homography_.process(frame, baseImage);
+                diff_.setBaseImage(baseImage);
+                // 複数フレームの指定があれば、続くフレームの平均（中央値）で差し替える
+                if (baseFrames_ > 1) {
+                    diff_.captureBaseImage(baseFrames_, isBaseMedian_);
+                }
+                isBaseFromFirstFrame_ = false;
+            }
+            // カメラは待たせると遅延が溜まるので、詰まっていたら捨てる
+            if (isLiveSource_) {
+                graph_.tryPush(frame);
+            } else {
+                graph_.push(frame);
+            }
+        } else {
+            // カメラが外れたときなどは少し待ってから読み直す
+            std::this_thread::sleep_for(milliseconds(100));
+        }
+
+        const auto t2 = high_resolution_clock::now();
+        const auto elapsed = duration_cast<microseconds>(t2 - fpsStart);
+        if (elapsed >= seconds(1)) {
+            const int completed = graph_.stats().completed;
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            currentFps_ = (completed - fpsCompleted) * 1000000.0 / elapsed.count();
+            fpsStart = t2;
+            fpsCompleted = completed;
+        }
+
+        if (fps_ <= 0) continue;
+        const auto waitTime = microseconds(1000000 / fps_) - duration_cast<microseconds>(t2 - t1);
+        if (waitTime > microseconds::zero()) {
+            std::this_thread::sleep_for(waitTime);
+        }
+    }
+}
+
+
+void HeadlessPipeline::publishMarkers(int width, int height)
+{
+    // MarkerTrackView.qml と同じメッセージを送る
+    QMap<unsigned int, QVariantMap> current;
+    for (const auto& marker : markerTracker_->markers()) {
+        auto message = toVariantMap(marker, width, height);
+        message.remove("image");
+        send("/marker/update", message);
+        current.insert(marker.id, message);
+    }
+    for (auto it = markers_.begin(); it != markers_.end(); ++it) {
+        if (!current.contains(it.key())) {
+            send("/marker/remove", it.value());
+        }
+    }
+    markers_.swap(current);
+}
+
+
+void HeadlessPipeline::publishLandolts(int width, int height)
+{
+    // LandoltTrackView.qml と同じメッセージを送る（キー名もそのまま）
+    QMap<unsigned int, QVariantMap> current;
+    for (const auto& item : landoltTracker_->items()) {
+        const auto landolt = toVariantMap(item, width, height);
+        QVariantMap message;
+        message.insert("id",          landolt["id"]);
+        message.insert("x",           landolt["x"]);
+        message.insert("y",           landolt["y"]);
+        message.insert("angle",       landolt["angle"]);
+        message.insert("radius",      landolt["radius"]);
+        message.insert("width",       landolt["width"]);
+        message.insert("height",      landolt["height"]);
+        message.insert("touched",     landolt["touched"]);
+        message.insert("toucheX",     landolt["touchX"]);
+        message.insert("toucheY",     landolt["touchY"]);
+        message.insert("toucheCount", landolt["touchCount"]);
+        message.insert("frameCount",  landolt["frameCount"]);
+        message.insert("lostCount",   landolt["lostCount"]);
+
+        if (!landolts_.contains(item.id)) {
+            send("/landolt/create", message);
+        }
+        send("/landolt/update", message);
+        current.insert(item.id, message);
+    }
+    for (auto it = landolts_.begin(); it != landolts_.end(); ++it) {
+        if (!current.contains(it.key())) {
+            send("/landolt/remove", it.value());
+        }
+    }
+    landolts_.swap(current);
+}
+
+
+void HeadlessPipeline::send(const QString& address, const QVariantMap& message)
+{
+    const auto json = QString::fromUtf8(QJsonDocument(QJsonObject::fromVariantMap(message)).toJson(QJsonDocument::Compact));
+    QMetaObject::invokeMethod(&osc_, "send", Qt::QueuedConnection,
+        Q_ARG(QString, address), Q_ARG(QString, json));
+}
+
+
+QJsonObject HeadlessPipeline::stats() const
+{
+    const auto graphStats = graph_.stats();
+
+    QJsonObject stages;
+    for (const auto& s : graphStats.nodes) {
+        QJsonObject stage;
+        stage.insert("count",   s.count);
+        stage.insert("dropped", s.dropped);
+        stage.insert("lastMs",  s.lastMs);
+        stage.insert("meanMs",  s.count > 0 ? s.totalMs / s.count : 0.0);
+        stage.insert("maxMs",   s.maxMs);
+        stages.insert(QString::fromStdString(s.name), stage);
+    }
+
+    QJsonObject o;
+    o.insert("frames",   graphStats.completed);
+    o.insert("rejected", graphStats.rejected);
+    o.insert("inFlight", graphStats.inFlight);
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        o.insert("fps", currentFps_);
+    }
+    o.insert("stages", stages);
+    if (landoltTracker_) {
+        o.insert("landoltMatch", QString::fromStdString(landoltTracker_->matchMethod()));
+    }
+    return o;
+}
+
+
+void HeadlessPipeline::sendStats()
+{
+    // 接続されたら 1 行の JSON を返して切る
+    while (auto socket = server_.nextPendingConnection()) {
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        socket->write(QJsonDocument(stats()).toJson(QJsonDocument::Compact));
+        socket->write("\n");
+        socket->disconnectFromServer();
+    }
+}
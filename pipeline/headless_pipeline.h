@@ -0,0 +1,84 @@
+﻿#ifndef HEADLESS_PIPELINE_H
+#define HEADLESS_PIPELINE_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QJsonObject>
+#include <QVariantMap>
+#include <QMap>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include "frame_source.h"
+#include "homography_engine.h"
+#include "diff_image_engine.h"
+#include "landolt_tracker_engine.h"
+#include "marker_tracker_engine.h"
+#include "pipeline_graph.h"
+#include "osc_sender.h"
+
+
+namespace Littai
+{
+
+
+// QML を使わずに source -> Homography -> DiffImage -> tracker -> OSC を回す
+// 各ステージは PipelineGraph 上で並列に（フレームをずらして）処理される
+// 設定は JSON ファイルから読み、統計はローカルソケットに JSON で返す
+class HeadlessPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeadlessPipeline(QObject* parent = nullptr);
+    ~HeadlessPipeline();
+
+    bool load(const QString& configPath);
+    QJsonObject stats() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void sendStats();
+
+private:
+    void run();
+    void publishMarkers(int width, int height);
+    void publishLandolts(int width, int height);
+    void send(const QString& address, const QVariantMap& message);
+
+    std::shared_ptr<FrameSource> source_;
+    HomographyEngine homography_;
+    DiffImageEngine diff_;
+    std::shared_ptr<MarkerTrackerEngine> markerTracker_;
+    std::shared_ptr<LandoltTrackerEngine> landoltTracker_;
+    bool isBaseFromFirstFrame_;
+    int baseFrames_;
+    bool isBaseMedian_;
+    bool isLiveSource_;
+    int fps_;
+
+    PipelineGraph graph_;
+    int threadCount_;
+
+    OSCSender osc_;
+    QLocalServer server_;
+    QString serverName_;
+
+    std::thread thread_;
+    std::atomic<bool> isRunning_;
+
+    // それぞれのトラッカーの通知からだけ触る（前のフレームから消えたものを remove で送るため）
+    QMap<unsigned int, QVariantMap> markers_, landolts_;
+
+    mutable std::mutex statsMutex_;
+    double currentFps_;
+};
+
+
+}
+
+#endif // HEADLESS_PIPELINE_H
@@ -0,0 +1,115 @@
+﻿#include <QDebug>
+#include <algorithm>
+#include <thread>
+#include "pipeline.h"
+#include "mat_metatype.h"
+
+using namespace Littai;
+
+
+
+void PipelineStage::detachFromPipeline()
+{
+    if (pipeline_) {
+        pipeline_->remove(this);
+    }
+}
+
+
+
+// ---
+
+
+
+Pipeline::Pipeline(QObject* parent)
+    : QObject(parent)
+    , threadCount_(std::max(static_cast<int>(std::thread::hardware_concurrency()), 2))
+    , maxInFlight_(4)
+    , queueCapacity_(2)
+{
+}
+
+
+Pipeline::~Pipeline()
+{
+    graph_.stop();
+    for (auto stage : stages_) {
+        stage->pipeline_ = nullptr;
+    }
+}
+
+
+QObject* Pipeline::source() const
+{
+    return source_;
+}
+
+
+void Pipeline::setSource(QObject* source)
+{
+    if (source_ == source) return;
+    if (source_) {
+        disconnect(source_, SIGNAL(imageChanged()), this, SLOT(pushSourceImage()));
+    }
+    source_ = source;
+    if (source_) {
+        connect(source_, SIGNAL(imageChanged()), this, SLOT(pushSourceImage()));
+    }
+    emit sourceChanged();
+}
+
+
+void Pipeline::attach(QObject* item, const QString& input)
+{
+    auto stage = dynamic_cast<PipelineStage*>(item);
+    if (!stage) {
+        qWarning() << item << "cannot be attached to Pipeline.";
+        return;
+    }
+    if (stage->pipeline_) {
+        stage->pipeline_->remove(stage);
+    }
+
+    stage->pipeline_ = this;
+    stages_.push_back(stage);
+    graph_.addNode(stage->stage().name(), stage->stage(), input.toStdString(), [stage](const cv::Mat& output) {
+        stage->setOutput(output);
+    });
+}
+
+
+void Pipeline::detach(QObject* item)
+{
+    auto stage = dynamic_cast<PipelineStage*>(item);
+    if (stage && stage->pipeline_ == this) {
+        remove(stage);
+    }
+}
+
+
+void Pipeline::remove(PipelineStage* stage)
+{
+    graph_.removeNode(stage->stage().name());
+    stages_.erase(std::remove(stages_.begin(), stages_.end(), stage), stages_.end());
+    stage->pipeline_ = nullptr;
+}
+
+
+void Pipeline::pushSourceImage()
+{
+    // source の画像はその場で書き換えられるので複製して渡す
+    const auto image = source_->property("image").value<cv::Mat>().clone();
+    if (image.empty()) return;
+
+    for (auto stage : stages_) {
+        stage->updateParams();
+    }
+    graph_.setMaxInFlight(maxInFlight_);
+    graph_.setQueueCapacity(queueCapacity_);
+
+    if (!graph_.isRunning()) {
+        graph_.start(threadCount_);
+    }
+    // GUI スレッドは待たせない
+    graph_.tryPush(image);
+}
@@ -0,0 +1,63 @@
+﻿#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <QObject>
+#include <QPointer>
+#include <vector>
+#include "pipeline_graph.h"
+#include "pipeline_stage.h"
+
+
+namespace Littai
+{
+
+
+// QML からパイプラインを組み立てる
+// source の画像が更新されるたびにグラフに流し、各ステージはワーカスレッドで処理される
+// 同時に処理中のフレームが maxInFlight に達しているときに来た画像は捨てる
+// QML 側は結果を表示するだけで、フレームの受け渡しには関わらない
+class Pipeline : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QObject* source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(int threadCount MEMBER threadCount_ NOTIFY threadCountChanged)
+    Q_PROPERTY(int maxInFlight MEMBER maxInFlight_ NOTIFY maxInFlightChanged)
+    Q_PROPERTY(int queueCapacity MEMBER queueCapacity_ NOTIFY queueCapacityChanged)
+
+public:
+    explicit Pipeline(QObject* parent = nullptr);
+    ~Pipeline();
+
+    QObject* source() const;
+    void setSource(QObject* source);
+
+    // input は入力元のステージ名（空ならグラフの入力）
+    Q_INVOKABLE void attach(QObject* item, const QString& input);
+    Q_INVOKABLE void detach(QObject* item);
+
+private slots:
+    void pushSourceImage();
+
+private:
+    void remove(PipelineStage* stage);
+
+    friend class PipelineStage;
+
+    PipelineGraph graph_;
+    std::vector<PipelineStage*> stages_;
+    QPointer<QObject> source_;
+    int threadCount_;
+    int maxInFlight_;
+    int queueCapacity_;
+
+signals:
+    void sourceChanged() const;
+    void threadCountChanged() const;
+    void maxInFlightChanged() const;
+    void queueCapacityChanged() const;
+};
+
+
+}
+
+#endif // PIPELINE_H
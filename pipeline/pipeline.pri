@@ -0,0 +1,12 @@
+include($$PWD/pipeline_core.pri)
+
+QT += network
+
+SOURCES += \
+    $$PWD/pipeline.cpp \
+    $$PWD/headless_pipeline.cpp \
+
+HEADERS += \
+    $$PWD/pipeline_stage.h \
+    $$PWD/pipeline.h \
+    $$PWD/headless_pipeline.h \
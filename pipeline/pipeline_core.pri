@@ -0,0 +1,7 @@
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/pipeline_graph.cpp \
+
+HEADERS += \
+    $$PWD/pipeline_graph.h \
@@ -0,0 +1,279 @@
+﻿#include <algorithm>
+#include <chrono>
+#include "pipeline_graph.h"
+
+using namespace Littai;
+
+
+
+PipelineGraph::PipelineGraph()
+    : isRunning_(false)
+    , queueCapacity_(2)
+    , maxInFlight_(4)
+    , frameIndex_(0)
+    , pushedCount_(0)
+    , rejectedCount_(0)
+    , completedCount_(0)
+{
+}
+
+
+PipelineGraph::~PipelineGraph()
+{
+    stop();
+}
+
+
+void PipelineGraph::setQueueCapacity(int capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    queueCapacity_ = std::max(capacity, 1);
+}
+
+
+void PipelineGraph::setMaxInFlight(int count)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        maxInFlight_ = std::max(count, 1);
+    }
+    slotCondition_.notify_all();
+}
+
+
+void PipelineGraph::addNode(const std::string& name, Stage& stage, const std::string& input, const Observer& observer)
+{
+    auto node = std::make_shared<Node>();
+    node->name      = name;
+    node->input     = input;
+    node->stage     = &stage;
+    node->observer  = observer;
+    node->isRunning = false;
+    node->stats.name    = name;
+    node->stats.count   = 0;
+    node->stats.dropped = 0;
+    node->stats.lastMs  = 0.0;
+    node->stats.totalMs = 0.0;
+    node->stats.maxMs   = 0.0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_.push_back(node);
+}
+
+
+void PipelineGraph::removeNode(const std::string& name)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = std::find_if(nodes_.begin(), nodes_.end(), [&](const std::shared_ptr<Node>& node) {
+        return node->name == name;
+    });
+    if (it == nodes_.end()) return;
+
+    const auto node = *it;
+    idleCondition_.wait(lock, [&] { return !node->isRunning; });
+    for (const auto& frame : node->queue) {
+        release(frame.index);
+    }
+    nodes_.erase(std::find(nodes_.begin(), nodes_.end(), node));
+}
+
+
+bool PipelineGraph::tryPush(const cv::Mat& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (static_cast<int>(references_.size()) >= maxInFlight_) {
+            ++rejectedCount_;
+            return false;
+        }
+        admit(frame);
+    }
+    condition_.notify_all();
+    return true;
+}
+
+
+void PipelineGraph::push(const cv::Mat& frame)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotCondition_.wait(lock, [&] {
+            return !isRunning_ || static_cast<int>(references_.size()) < maxInFlight_;
+        });
+        admit(frame);
+    }
+    condition_.notify_all();
+}
+
+
+void PipelineGraph::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    slotCondition_.wait(lock, [&] { return !isRunning_ || references_.empty(); });
+}
+
+
+void PipelineGraph::start(int threadCount)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (isRunning_) return;
+    isRunning_ = true;
+    for (int i = 0; i < std::max(threadCount, 1); ++i) {
+        threads_.push_back(std::thread(&PipelineGraph::run, this));
+    }
+}
+
+
+void PipelineGraph::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isRunning_ = false;
+    }
+    condition_.notify_all();
+    slotCondition_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+}
+
+
+bool PipelineGraph::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isRunning_;
+}
+
+
+PipelineGraph::Stats PipelineGraph::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.pushed    = pushedCount_;
+    stats.rejected  = rejectedCount_;
+    stats.completed = completedCount_;
+    stats.inFlight  = static_cast<int>(references_.size());
+    for (const auto& node : nodes_) {
+        stats.nodes.push_back(node->stats);
+    }
+    return stats;
+}
+
+
+void PipelineGraph::run()
+{
+    using namespace std::chrono;
+
+    for (;;) {
+        Frame input;
+        std::shared_ptr<Node> node;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [&] { return !isRunning_ || (node = acquire(input)); });
+            if (!isRunning_) break;
+        }
+
+        Frame output;
+        output.index = input.index;
+        const auto t1 = high_resolution_clock::now();
+        node->stage->process(input.image, output.image);
+        const auto t2 = high_resolution_clock::now();
+        const double ms = duration_cast<microseconds>(t2 - t1).count() / 1000.0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& stats = node->stats;
+            ++stats.count;
+            stats.lastMs   = ms;
+            stats.totalMs += ms;
+            stats.maxMs    = std::max(stats.maxMs, ms);
+            if (!output.image.empty()) {
+                forward(node->name, output);
+            }
+        }
+        condition_.notify_all();
+
+        // 表示側への通知は後段に渡してから行う
+        if (!output.image.empty() && node->observer) {
+            node->observer(output.image);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            node->isRunning = false;
+            release(input.index);
+        }
+        condition_.notify_all();
+        idleCondition_.notify_all();
+    }
+    idleCondition_.notify_all();
+}
+
+
+void PipelineGraph::admit(const cv::Mat& frame)
+{
+    Frame input;
+    input.index = frameIndex_++;
+    input.image = frame;
+    ++pushedCount_;
+
+    // 受け取るノードが無くても 1 度は完了扱いにする
+    retain(input.index);
+    forward("", input);
+    release(input.index);
+}
+
+
+std::shared_ptr<PipelineGraph::Node> PipelineGraph::acquire(Frame& frame)
+{
+    std::shared_ptr<Node> oldest;
+    for (const auto& node : nodes_) {
+        if (node->isRunning || node->queue.empty()) continue;
+        if (!oldest || node->queue.front().index < oldest->queue.front().index) {
+            oldest = node;
+        }
+    }
+    if (!oldest) return oldest;
+
+    // キューに入っていた分の参照はそのまま処理中の参照になる
+    frame = oldest->queue.front();
+    oldest->queue.pop_front();
+    oldest->isRunning = true;
+    return oldest;
+}
+
+
+void PipelineGraph::forward(const std::string& name, const Frame& frame)
+{
+    for (const auto& node : nodes_) {
+        if (node->input != name) continue;
+
+        // 間に合わないときは古いフレームから捨てる
+        while (static_cast<int>(node->queue.size()) >= queueCapacity_) {
+            release(node->queue.front().index);
+            node->queue.pop_front();
+            ++node->stats.dropped;
+        }
+        retain(frame.index);
+        node->queue.push_back(frame);
+    }
+}
+
+
+void PipelineGraph::retain(std::int64_t index)
+{
+    ++references_[index];
+}
+
+
+void PipelineGraph::release(std::int64_t index)
+{
+    auto it = references_.find(index);
+    if (it == references_.end()) return;
+    if (--it->second > 0) return;
+
+    references_.erase(it);
+    ++completedCount_;
+    slotCondition_.notify_all();
+}
@@ -0,0 +1,115 @@
+﻿#ifndef PIPELINE_GRAPH_H
+#define PIPELINE_GRAPH_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include "stage.h"
+
+
+namespace Littai
+{
+
+
+// Stage をノード、フレームのキューを辺とするグラフと、それを回すスケジューラ（Qt に依存しない）
+// 各ノードは 1 度に 1 フレームずつ、来た順に処理するので Stage の中の状態は守られる
+// 空いたスレッドは待っているノードのうち一番古いフレームを持つものを処理するので、
+// フレーム N を追跡している間に N + 1 の差分、N + 2 の射影変換が進む
+class PipelineGraph
+{
+public:
+    typedef std::function<void(const cv::Mat& output)> Observer;
+
+    struct NodeStats
+    {
+        std::string name;
+        int count;
+        int dropped;          // キューがあふれて捨てたフレーム数
+        double lastMs, totalMs, maxMs;
+    };
+
+    struct Stats
+    {
+        int pushed;           // グラフに入ったフレーム数
+        int rejected;         // maxInFlight に達していて入れなかったフレーム数
+        int completed;        // グラフを抜けた（最後まで処理したか途中で捨てた）フレーム数
+        int inFlight;
+        std::vector<NodeStats> nodes;
+    };
+
+    PipelineGraph();
+    ~PipelineGraph();
+
+    // 各辺に溜められるフレーム数（あふれたら古いものから捨てる）
+    void setQueueCapacity(int capacity);
+    // 同時にグラフの中にいられるフレーム数
+    void setMaxInFlight(int count);
+
+    // input が空のノードはグラフの入力 (push) を受け取る
+    // input のノードがまだ無くても良い（追加された時点でつながる）
+    void addNode(const std::string& name, Stage& stage, const std::string& input, const Observer& observer);
+    // 処理中なら終わるのを待ってから外す
+    void removeNode(const std::string& name);
+
+    // maxInFlight に達していたら捨てて false を返す（カメラなど待てない入力用）
+    bool tryPush(const cv::Mat& frame);
+    // 空きができるまで待ってから流す（録画ファイルなど全フレーム処理したい入力用）
+    void push(const cv::Mat& frame);
+    // 流したフレームがすべて処理し終わるまで待つ
+    void waitForIdle();
+
+    void start(int threadCount);
+    void stop();
+    bool isRunning() const;
+
+    Stats stats() const;
+
+private:
+    struct Frame
+    {
+        std::int64_t index;
+        cv::Mat image;
+    };
+
+    struct Node
+    {
+        std::string name, input;
+        Stage* stage;
+        Observer observer;
+        std::deque<Frame> queue;
+        bool isRunning;
+        NodeStats stats;
+    };
+
+    void run();
+    void admit(const cv::Mat& frame);
+    std::shared_ptr<Node> acquire(Frame& frame);
+    void forward(const std::string& name, const Frame& frame);
+    void retain(std::int64_t index);
+    void release(std::int64_t index);
+
+    std::vector<std::shared_ptr<Node>> nodes_;
+    std::vector<std::thread> threads_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_, idleCondition_, slotCondition_;
+    bool isRunning_;
+    int queueCapacity_;
+    int maxInFlight_;
+    std::int64_t frameIndex_;
+
+    // フレームごとに、キューに入っているか処理中のノードの数
+    std::map<std::int64_t, int> references_;
+    int pushedCount_, rejectedCount_, completedCount_;
+};
+
+
+}
+
+#endif // PIPELINE_GRAPH_H
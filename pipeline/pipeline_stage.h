@@ -0,0 +1,39 @@
+﻿#ifndef PIPELINE_STAGE_H
+#define PIPELINE_STAGE_H
+
+#include "stage.h"
+
+
+namespace Littai
+{
+
+
+class Pipeline;
+
+
+// Pipeline につなげる QML アイテムが実装する
+class PipelineStage
+{
+public:
+    PipelineStage() : pipeline_(nullptr) {}
+    virtual ~PipelineStage() {}
+
+    virtual Stage& stage() = 0;
+    // フレームを流す前に GUI スレッドから呼ばれる（プロパティをエンジンに反映する）
+    virtual void updateParams() = 0;
+    // 処理スレッドから呼ばれる（結果を表示する）
+    virtual void setOutput(const cv::Mat& output) = 0;
+
+protected:
+    // 派生クラスのデストラクタの最初で呼ぶ（処理中なら終わるまで待つ）
+    void detachFromPipeline();
+
+private:
+    friend class Pipeline;
+    Pipeline* pipeline_;
+};
+
+
+}
+
+#endif // PIPELINE_STAGE_H
@@ -17,8 +17,8 @@ ApplicationWindow {
     height: 900
 
     property var homographyImage: null
-    property var diffImage: null
     property alias osc : osc
+    property alias pipeline : pipeline
 
     Storage {
         id: storage
@@ -26,6 +26,10 @@ ApplicationWindow {
         description: 'Interaction recognizer for LITTAI project.'
     }
 
+    Pipeline {
+        id: pipeline
+    }
+
     Osc {
         id: osc
         ip: storage.get('osc.ip') || '127.0.0.1'
@@ -10,6 +10,7 @@ ColumnLayout {
     spacing: 10
     property string baseImagePath: 'D:/littai/img/baseImage.png'
     property string intensityCorrectionImagePath: 'D:/littai/img/intensityCorrectionImage.png'
+    property int baseImageFrames: 30
 
     Storage {
         id: storage
@@ -113,11 +114,18 @@ ColumnLayout {
             sharpness: sharpnessSlider.value
             intensityCorrectionMin: intensityCorrectionMinSlider.value
             intensityCorrectionMax: intensityCorrectionMaxSlider.value
-            inputImage: inputImage.image
-            baseImage: base.image
-            onImageChanged: {
-                fpsCounter.update();
-                window.diffImage = image;
+            onImageChanged: fpsCounter.update()
+            // キャプチャした基準画像はエンジンが差し替え済みなので、表示と保存だけ
+            onBaseImageCaptured: {
+                base.image = capturedImage;
+                baseIntensity.image = diff.intensityCorrectionImage;
+                base.saveToFile(baseImagePath);
+                baseIntensity.saveToFile(intensityCorrectionImagePath);
+            }
+            Component.onCompleted: {
+                // 保存してあった基準画像は起動時に一度だけ渡す
+                diff.baseImage = base.image;
+                window.pipeline.attach(diff, 'homography');
             }
 
             Layout.fillWidth: true
@@ -136,7 +144,7 @@ ColumnLayout {
             spacing: 30
 
             Button {
-                text: "Set Base Image As Current"
+                text: "Capture Base Image"
                 onClicked: setBaseImage()
             }
 
@@ -191,10 +199,8 @@ ColumnLayout {
         }
     }
 
+    // 次の baseImageFrames 枚の平均で撮り直す（終わると onBaseImageCaptured）
     function setBaseImage() {
-        base.image = inputImage.image;
-        baseIntensity.image = diff.intensityCorrectionImage;
-        base.saveToFile(baseImagePath);
-        baseIntensity.saveToFile(intensityCorrectionImagePath);
+        diff.captureBaseImage(baseImageFrames);
     }
 }
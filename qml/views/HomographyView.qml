@@ -65,6 +65,18 @@ ColumnLayout {
             }
             */
 
+            /*
+            Replay {
+                id: replay
+                width: 1
+                height: 1
+                recordPath: 'D:/littai/record/session.ltfr'
+                isRealTime: true
+                isLoop: true
+                Component.onCompleted: start()
+            }
+            */
+
             KinectV2 {
                 id: kinect
                 width: 1
@@ -106,7 +118,6 @@ ColumnLayout {
 
         Homography {
             id: homography
-            image: reversed.image
             onImageChanged: {
                 window.homographyImage = image;
                 homographyFpsCounter.update();
@@ -114,6 +125,10 @@ ColumnLayout {
             srcPoints: targetArea.points
             outputWidth: 480
             outputHeight: 480
+            Component.onCompleted: {
+                window.pipeline.source = reversed;
+                window.pipeline.attach(homography, '');
+            }
 
             Layout.fillWidth: true
             Layout.fillHeight: true
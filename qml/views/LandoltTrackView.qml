@@ -21,7 +21,8 @@ ColumnLayout {
             toucheX: landolt.touchX,
             toucheY: landolt.touchY,
             toucheCount: landolt.touchCount,
-            frameCount: landolt.frameCount
+            frameCount: landolt.frameCount,
+            lostCount: landolt.lostCount
         });
     }
 
@@ -49,9 +50,8 @@ ColumnLayout {
             Layout.maximumWidth: parent.width / 2
             Layout.maximumHeight: parent.height
 
-            inputImage: window.diffImage
             fps: 30
-            onInputImageChanged: update()
+            Component.onCompleted: window.pipeline.attach(landoltTracker, 'diff')
             templateImage: templateImage.image
             templateThreshold: templateThresholdSlider.value
             contrastThreshold: contrastThresholdSlider.value
@@ -37,8 +37,7 @@ ColumnLayout {
 
             fps: 30
             predictionFrame: predictionFrameSlider.value
-            inputImage: window.diffImage
-            onInputImageChanged: update()
+            Component.onCompleted: window.pipeline.attach(markerTracker, 'diff')
             contrastThreshold: contrastSlider.value
             contrastThresholdMin: contrastSliderMin.value
             contrastThresholdMax: contrastSliderMax.value